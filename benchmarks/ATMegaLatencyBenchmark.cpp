@@ -0,0 +1,227 @@
+/**
+ * End-to-end latency of the ATMega control path, on the simulated Controller.
+ *
+ * Publishes joystick axes and commands through an in-process broker, to the
+ * same Listener and SPI classes of PolitoceanATMega, and measures the time
+ * from each publish to the first SPI byte of the matching frame.
+ * Axes are published as text, or with "binary" in the AxesPayload encoding,
+ * whose sequence restarts from 0 halfway as after a restart of the publisher:
+ * the Listener must resync to it instead of timing out on every axes frame.
+ *
+ * Usage: ATMegaLatencyBenchmark [messages] [binary]
+ */
+
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ATMega.h"
+#include "PolitoceanUtils.hpp"
+
+#include "Latency.h"
+
+namespace
+{
+    const std::chrono::milliseconds TIMEOUT(1000);
+
+    /**
+     * Looks for @frame_ among the SPI bytes sent, starting from the moment it is armed.
+     * @start_ is the timestamp of the first byte of the last partial match.
+     */
+    class FrameMatcher
+    {
+        std::vector<unsigned char> frame_;
+        std::size_t matched_;
+        long long start_, found_;
+        bool armed_;
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+
+    public:
+        FrameMatcher() : matched_(0), start_(0), found_(0), armed_(false) {}
+
+        void arm(const std::vector<unsigned char>& frame)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            frame_      = frame;
+            matched_    = 0;
+            found_      = 0;
+            armed_      = true;
+        }
+
+        void observe(const Controller::Event& event)
+        {
+            if (event.type != Controller::Event::Type::SPI)
+                return;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            if (!armed_)
+                return;
+
+            unsigned char data = static_cast<unsigned char>(event.value);
+
+            if (data != frame_[matched_])
+                matched_ = 0;
+
+            if (data == frame_[matched_] && matched_++ == 0)
+                start_ = event.timestamp;
+
+            if (matched_ < frame_.size())
+                return;
+
+            found_ = start_;
+            armed_ = false;
+            cv_.notify_one();
+        }
+
+        // Returns the timestamp of the matching frame, 0 on timeout
+        long long wait(std::chrono::milliseconds timeout)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            cv_.wait_for(lock, timeout, [this]() { return found_ != 0; });
+            armed_ = false;
+
+            return found_;
+        }
+    };
+
+    unsigned char axisByte(int axis)
+    {
+        return static_cast<unsigned char>(Politocean::map(axis, SHRT_MIN, SHRT_MAX, 1, UCHAR_MAX - 1));
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    int messages = argc > 1 ? std::atoi(argv[1]) : 500;
+    bool binary = argc > 2 && std::string(argv[2]) == "binary";
+
+    Controller controller;
+    controller.setup();
+
+    Listener listener;
+    SPI spi(controller);
+    spi.setup();
+
+    FrameMatcher matcher;
+    controller.setObserver([&](const Controller::Event& event) { matcher.observe(event); });
+
+    Latency::Broker broker;
+
+    broker.subscribe(Topics::AXES, [&](const std::string& payload, const std::string&) {
+        Types::Vector<int> axes;
+        std::istringstream values(payload);
+
+        int value;
+        while (values >> value)
+            axes.emplace_back(value);
+
+        listener.listenForAxes(axes);
+    });
+    broker.subscribe(Topics::AXES_BINARY, [&](const std::string& payload, const std::string&) {
+        listener.listenForAxesBinary(payload);
+    });
+    broker.subscribe(Topics::COMMANDS, [&](const std::string& payload, const std::string&) {
+        listener.listenForCommands(payload);
+    });
+
+    spi.startSPI(listener);
+
+    const std::pair<std::string, Commands::ATMega::Command> commands[] = {
+        { Commands::Actions::ATMega::VUP_ON,    Commands::ATMega::Command::VUP_ON   },
+        { Commands::Actions::ATMega::VUP_OFF,   Commands::ATMega::Command::VUP_OFF  },
+        { Commands::Actions::ATMega::VDOWN_ON,  Commands::ATMega::Command::VDOWN_ON },
+        { Commands::Actions::ATMega::VDOWN_OFF, Commands::ATMega::Command::VDOWN_OFF}
+    };
+
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> axis(SHRT_MIN, SHRT_MAX);
+    std::uniform_int_distribution<int> pause(0, 2 * Timing::Milliseconds::AXES_DELAY);
+
+    Latency::Samples axesLatency, commandsLatency;
+    std::vector<unsigned char> lastAxes;
+
+    for (int i = 0; i < messages; i++)
+    {
+        // Joystick axes, different from the last ones so that keepalive frames don't match
+        std::vector<int> axes;
+        std::vector<unsigned char> frame;
+
+        do
+        {
+            axes    = { axis(random), axis(random), axis(random), axis(random) };
+            frame   = { Commands::ATMega::SPI::Delims::AXES };
+
+            for (int value : axes)
+                frame.push_back(axisByte(value));
+        } while (frame == lastAxes);
+
+        lastAxes = frame;
+
+        std::string topic = Topics::AXES, payload;
+
+        if (binary)
+        {
+            // The publisher restarts, at least RESYNC after its last payload
+            if (i == messages / 2)
+                std::this_thread::sleep_for(AxesOrdering::RESYNC);
+
+            AxesPayload::Axes encoded = { static_cast<std::uint32_t>(i < messages / 2 ? i : i - messages / 2) };
+            std::copy(axes.begin(), axes.end(), encoded.values);
+
+            topic   = Topics::AXES_BINARY;
+            payload = AxesPayload::encode(encoded);
+        }
+        else
+        {
+            std::ostringstream text;
+            for (int value : axes)
+                text << value << ' ';
+
+            payload = text.str();
+        }
+
+        matcher.arm(frame);
+        long long sent = Latency::now();
+        broker.publish(topic, payload);
+
+        long long found = matcher.wait(TIMEOUT);
+        if (found)
+            axesLatency.add(found - sent);
+        else
+            axesLatency.timeout();
+
+        // Commands, each one a different frame from the previous
+        const std::pair<std::string, Commands::ATMega::Command> &command = commands[i % 4];
+
+        matcher.arm({ Commands::ATMega::SPI::Delims::COMMAND, Commands::ATMega::SPI::CODES[static_cast<int>(command.second)] });
+        sent = Latency::now();
+        broker.publish(Topics::COMMANDS, command.first);
+
+        found = matcher.wait(TIMEOUT);
+        if (found)
+            commandsLatency.add(found - sent);
+        else
+            commandsLatency.timeout();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(pause(random)));
+    }
+
+    spi.stopSPI();
+    controller.setObserver(nullptr);
+
+    axesLatency.report("axes");
+    commandsLatency.report("commands");
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+/**
+ * Replay of a PolitoceanATMega capture, on the simulated Controller.
+ *
+ * Delivers the messages of @capture, recorded with POLITOCEAN_CAPTURE, to the
+ * same Listener and SPI classes of PolitoceanATMega, @speed times faster than
+ * they were received, or back to back with a @speed of 0.
+ * The SPI frames and the pins written are recorded into @output, on the time
+ * base of @capture, and compared with the ones of @reference if given, e.g.
+ * the output of the replay of the same capture before a change.
+ * Axes are sent at most once every AXES_DELAY, so the AXES frames only match
+ * at the captured pace.
+ *
+ * Usage: ATMegaReplay capture [speed] [output] [reference]
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "ATMega.h"
+
+#include "Replay.h"
+
+namespace
+{
+    // Time left to the SPI thread for the last messages
+    const std::chrono::milliseconds DRAIN(500);
+
+    // Parses the AXES payloads, recorded as JSON arrays
+    Types::Vector<int> axes(const std::string& payload)
+    {
+        std::string text = payload;
+        for (char& c : text)
+            if (c == '[' || c == ']' || c == ',')
+                c = ' ';
+
+        Types::Vector<int> values;
+        std::istringstream stream(text);
+
+        int value;
+        while (stream >> value)
+            values.emplace_back(value);
+
+        return values;
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "Usage: %s capture [speed] [output] [reference]\n", argv[0]);
+        return 1;
+    }
+
+    double speed        = argc > 2 ? std::atof(argv[2]) : 1;
+    std::string output  = argc > 3 ? argv[3] : "atmega-replay.ptoc";
+
+    Capture::Reader reader;
+    if (!reader.open(argv[1]))
+    {
+        std::fprintf(stderr, "%s is not a capture\n", argv[1]);
+        return 1;
+    }
+
+    Capture::Recorder recorder;
+    if (!recorder.open(output))
+    {
+        std::fprintf(stderr, "Can't create %s\n", output.c_str());
+        return 1;
+    }
+    recorder.setSpeed(speed);
+
+    Controller controller;
+    controller.setup();
+
+    // The SPI frames are recorded by SPI itself
+    controller.setObserver([&](const Controller::Event& event) {
+        if (event.type == Controller::Event::Type::LEVEL)
+        {
+            unsigned char level = event.value;
+            recorder.output(Capture::Kind::LEVEL, event.pin, &level, sizeof(level));
+        }
+        else if (event.type == Controller::Event::Type::PWM)
+        {
+            std::uint32_t value = event.value;
+            recorder.output(Capture::Kind::PWM, event.pin, &value, sizeof(value));
+        }
+    });
+
+    Listener listener;
+    SPI spi(controller);
+    spi.setup();
+    spi.setRecorder(&recorder);
+
+    spi.startSPI(listener);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    unsigned long long captured = 0;
+
+    // The replay thread stands for the MQTT one
+    unsigned long messages = Replay::run(reader, speed, [&](const Capture::Record& record) {
+        captured = record.timestamp;
+
+        if (record.topic == Topics::AXES)
+            listener.listenForAxes(axes(record.data));
+        else if (record.topic == Topics::AXES_BINARY)
+            listener.listenForAxesBinary(record.data);
+        else if (record.topic == Topics::COMMANDS)
+            listener.listenForCommands(record.data);
+    });
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::this_thread::sleep_for(DRAIN);
+
+    spi.stopSPI();
+    controller.setObserver(nullptr);
+    recorder.close();
+
+    std::printf("%lu messages, %.3f s captured in %.3f s, %lu records dropped\n",
+        messages, captured / 1e9, elapsed.count(), recorder.dropped());
+
+    if (argc > 4 && !Replay::diff(argv[4], output))
+        return 2;
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * CPU cost of a running DCMotor.
+ *
+ * Runs the hand motor for a few seconds with a constant velocity (idle) and
+ * then with velocity updates at a given rate, and prints the CPU time used by
+ * the process as a percentage of one core.
+ *
+ * Usage: DCMotorBenchmark [seconds] [updates per second]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <time.h>
+
+#include "Controller.h"
+#include "DCMotor.h"
+#include "PolitoceanConstants.h"
+
+using namespace Politocean::RPi;
+using namespace Politocean::Constants;
+
+namespace
+{
+    double cpuSeconds()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+
+    void run(const char *name, DCMotor &motor, int seconds, int rate)
+    {
+        auto start  = std::chrono::steady_clock::now();
+        auto end    = start + std::chrono::seconds(seconds);
+        double cpu  = cpuSeconds();
+
+        int velocity = DCMotor::PWM_MIN;
+        while (std::chrono::steady_clock::now() < end)
+        {
+            if (rate <= 0)
+            {
+                std::this_thread::sleep_until(end);
+                break ;
+            }
+
+            velocity = velocity < DCMotor::PWM_MAX ? velocity + 1 : DCMotor::PWM_MIN;
+            motor.setVelocity(velocity);
+
+            std::this_thread::sleep_for(std::chrono::microseconds(1000000 / rate));
+        }
+
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%-8s %6d updates/s  cpu %6.2f%% of a core\n", name, rate, 100 * (cpuSeconds() - cpu) / wall);
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    int seconds = argc > 1 ? std::atoi(argv[1]) : 5;
+    int rate    = argc > 2 ? std::atoi(argv[2]) : 50;
+
+    Controller controller;
+    controller.setup();
+
+    DCMotor motor(&controller, Pinout::HAND_DIR, Pinout::HAND_PWM, DCMotor::PWM_MIN, DCMotor::PWM_MAX);
+    motor.setup();
+
+    motor.setDirection(Direction::CW);
+    motor.setVelocity(DCMotor::PWM_MIN);
+    motor.startPwm();
+
+    run("idle", motor, seconds, 0);
+    run("updates", motor, seconds, rate);
+
+    motor.stopPwm();
+    controller.reset();
+
+    return 0;
+}
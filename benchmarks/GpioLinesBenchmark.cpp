@@ -0,0 +1,135 @@
+/**
+ * Cost of writing the step pins of several steppers, one call per pin against
+ * a single GpioLines batch.
+ *
+ * Requests @lines consecutive lines of @chip from @first on, then toggles them
+ * @toggles times, all together, in three ways:
+ *  (*) controller  : Controller::digitalWrite() for each pin
+ *  (*) lines       : GpioLines::write() for each pin, one ioctl per pin
+ *  (*) batch       : one GpioLines::write() of a Batch with all the pins
+ * and prints the time per toggle of all the lines. After every chardev toggle
+ * the lines are read back with GpioLines::read(), and any mismatch is counted.
+ *
+ * Any machine can run it on the gpio-sim module, e.g. as root:
+ *   modprobe gpio-sim
+ *   mkdir -p /sys/kernel/config/gpio-sim/rov/gpio-bank0
+ *   echo 16 > /sys/kernel/config/gpio-sim/rov/gpio-bank0/num_lines
+ *   echo 1 > /sys/kernel/config/gpio-sim/rov/live
+ *   GpioLinesBenchmark /dev/$(cat /sys/kernel/config/gpio-sim/rov/gpio-bank0/chip_name) 0 9
+ *
+ * Usage: GpioLinesBenchmark chip first [lines] [toggles]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Controller.h"
+#include "GpioLines.h"
+
+#include "Latency.h"
+
+using namespace Politocean::RPi;
+
+namespace
+{
+    Controller::PinLevel level(int toggle)
+    {
+        return toggle % 2 ? Controller::PinLevel::PIN_LOW : Controller::PinLevel::PIN_HIGH;
+    }
+
+    // Runs @toggle @toggles times, prints the mean, median and max time of each call
+    void measure(const char *mode, int toggles, std::function<void(int)> toggle, std::function<bool(int)> check)
+    {
+        std::vector<long long> times;
+        times.reserve(toggles);
+
+        unsigned long mismatches = 0;
+
+        for (int i = 0; i < toggles; i++)
+        {
+            long long start = Latency::now();
+            toggle(i);
+            times.push_back(Latency::now() - start);
+
+            if (check && !check(i))
+                mismatches++;
+        }
+
+        std::sort(times.begin(), times.end());
+
+        long long sum = 0;
+        for (long long time : times)
+            sum += time;
+
+        std::printf("%-11s %8d %9.2f %9.2f %9.2f %10lu\n", mode, toggles,
+            sum / 1e3 / toggles, times[times.size() / 2] / 1e3, times.back() / 1e3, mismatches);
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    if (argc < 3)
+    {
+        std::fprintf(stderr, "Usage: %s chip first [lines] [toggles]\n", argv[0]);
+        return 1;
+    }
+
+    std::string chip    = argv[1];
+    int first           = std::atoi(argv[2]);
+    int count           = argc > 3 ? std::atoi(argv[3]) : 9;
+    int toggles         = argc > 4 ? std::atoi(argv[4]) : 100000;
+
+    Controller controller;
+    controller.setup();
+
+    std::vector<int> pins;
+    for (int pin = first; pin < first + count; pin++)
+    {
+        controller.pinMode(pin, Controller::PinMode::PIN_OUTPUT);
+        controller.digitalWrite(pin, Controller::PinLevel::PIN_LOW);
+        pins.push_back(pin);
+    }
+
+    std::printf("%-11s %8s %9s %9s %9s %10s\n", "mode", "toggles", "mean_us", "p50_us", "max_us", "mismatches");
+
+    measure("controller", toggles, [&](int toggle) {
+        for (int pin : pins)
+            controller.digitalWrite(pin, level(toggle));
+    }, nullptr);
+
+    GpioLines lines(controller);
+    if (!lines.setup(chip, pins, "GpioLinesBenchmark"))
+    {
+        std::fprintf(stderr, "Can't request lines %d-%d of %s\n", first, first + count - 1, chip.c_str());
+        return 1;
+    }
+
+    auto check = [&](int toggle) {
+        for (int pin : pins)
+            if (lines.read(pin) != level(toggle))
+                return false;
+
+        return true;
+    };
+
+    measure("lines", toggles, [&](int toggle) {
+        for (int pin : pins)
+            lines.write(pin, level(toggle));
+    }, check);
+
+    GpioLines::Batch batch;
+
+    measure("batch", toggles, [&](int toggle) {
+        batch.clear();
+        for (int pin : pins)
+            batch.add(pin, level(toggle));
+
+        lines.write(batch);
+    }, check);
+
+    return lines.isRequested() ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+/**
+ * Helpers for the end-to-end latency benchmarks.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+
+namespace Latency
+{
+    // CLOCK_MONOTONIC time in nanoseconds, the clock of the simulated Controller events
+    inline long long now()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return static_cast<long long>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+
+    /**
+     * In-process stand-in for the MQTT broker and client.
+     * Messages are queued by publish() and delivered to the subscriber callbacks
+     * from a separate thread, like the MQTT client does.
+     */
+    class Broker
+    {
+    public:
+        typedef std::function<void(const std::string& payload, const std::string& topic)> Callback;
+
+    private:
+        struct Message
+        {
+            std::string topic, payload;
+        };
+
+        std::map<std::string, Callback> subscribers_;
+
+        std::queue<Message> messages_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+
+        bool isRunning_;
+        std::thread *th_;
+
+    public:
+        Broker() : isRunning_(true), th_(nullptr)
+        {
+            th_ = new std::thread([this]() {
+                std::unique_lock<std::mutex> lock(mutex_);
+
+                while (isRunning_)
+                {
+                    cv_.wait(lock, [this]() { return !messages_.empty() || !isRunning_; });
+
+                    while (!messages_.empty())
+                    {
+                        Message message = messages_.front();
+                        messages_.pop();
+
+                        auto subscriber = subscribers_.find(message.topic);
+                        if (subscriber == subscribers_.end())
+                            continue;
+
+                        lock.unlock();
+                        subscriber->second(message.payload, message.topic);
+                        lock.lock();
+                    }
+                }
+            });
+        }
+
+        ~Broker()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                isRunning_ = false;
+            }
+
+            cv_.notify_one();
+            th_->join();
+            delete th_;
+        }
+
+        // Subscribers must be added before the first message is published
+        void subscribe(const std::string& topic, Callback callback)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            subscribers_[topic] = callback;
+        }
+
+        void publish(const std::string& topic, const std::string& payload)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                messages_.push({ topic, payload });
+            }
+
+            cv_.notify_one();
+        }
+    };
+
+    // Latencies of one message class, in nanoseconds
+    class Samples
+    {
+        std::vector<long long> samples_;
+        unsigned long timeouts_;
+
+    public:
+        Samples() : timeouts_(0) {}
+
+        void add(long long latency) { samples_.push_back(latency); }
+        void timeout() { timeouts_++; }
+
+        void report(const char *name)
+        {
+            if (samples_.empty())
+            {
+                std::printf("%-10s no samples, %lu timeouts\n", name, timeouts_);
+                return;
+            }
+
+            std::sort(samples_.begin(), samples_.end());
+
+            auto percentile = [this](double p) {
+                return samples_[std::min(samples_.size() - 1, static_cast<std::size_t>(p * samples_.size()))] / 1e3;
+            };
+
+            std::printf("%-10s n %6zu  p50 %9.1f us  p99 %9.1f us  max %9.1f us  timeouts %lu\n",
+                name, samples_.size(), percentile(0.5), percentile(0.99), samples_.back() / 1e3, timeouts_);
+        }
+    };
+}
+
+#endif // LATENCY_H
@@ -0,0 +1,501 @@
+/**
+ * Step timing and CPU cost of the motor classes, on the simulated Controller.
+ *
+ * Runs the steppers at several rates, alone or together, with their own
+ * threads, with the MotionScheduler or through step(), with and without
+ * background load, and the DCMotor soft PWM. For each run it prints the
+ * achieved step rate, the error of the intervals between step edges against
+ * the requested half period, the missed edges and the CPU time of the motor
+ * threads. Rows are also written to @csv if given, to compare runs.
+ *
+ * The real-time profile is taken from the environment as in the ROV binaries
+ * (see Realtime::fromEnvironment()), e.g. to compare runs with POLITOCEAN_RT=1
+ * and without. Only the motor threads get it, the load threads don't.
+ *
+ * Usage: MotorsBenchmark [seconds per run] [csv] [cycles]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Controller.h"
+#include "DCMotor.h"
+#include "Stepper.h"
+#include "MotionScheduler.h"
+#include "Realtime.h"
+
+#include "Latency.h"
+
+using namespace Politocean::RPi;
+
+namespace
+{
+    const int FIRST_PIN     = 100;
+    const int MAX_MOTORS    = 3;
+
+    // Upper bounds in microseconds of the jitter histogram buckets, the last one is open
+    const long long BUCKETS[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 };
+    const std::size_t BUCKETS_COUNT = sizeof(BUCKETS) / sizeof(BUCKETS[0]) + 1;
+
+    int tid()
+    {
+        return static_cast<int>(syscall(SYS_gettid));
+    }
+
+    // Run time in nanoseconds of every thread of the process
+    std::map<int, long long> threadsTime()
+    {
+        std::map<int, long long> times;
+
+        DIR *tasks = opendir("/proc/self/task");
+        if (!tasks)
+            return times;
+
+        while (dirent *task = readdir(tasks))
+        {
+            if (task->d_name[0] == '.')
+                continue;
+
+            std::ifstream schedstat(std::string("/proc/self/task/") + task->d_name + "/schedstat");
+
+            long long time;
+            if (schedstat >> time)
+                times[std::atoi(task->d_name)] = time;
+        }
+
+        closedir(tasks);
+        return times;
+    }
+
+    // Threads spinning on every core, to see how the motor threads cope with a busy system
+    class Load
+    {
+        std::atomic<bool> isRunning_;
+        std::vector<std::thread> threads_;
+
+        std::mutex mutex_;
+        std::vector<int> tids_;
+
+    public:
+        Load(unsigned threads) : isRunning_(true)
+        {
+            for (unsigned i = 0; i < threads; i++)
+                threads_.emplace_back([this]() {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        tids_.push_back(tid());
+                    }
+
+                    volatile unsigned long spin = 0;
+                    while (isRunning_)
+                        spin++;
+                });
+        }
+
+        ~Load()
+        {
+            isRunning_ = false;
+
+            for (std::thread &thread : threads_)
+                thread.join();
+        }
+
+        std::vector<int> tids()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return tids_;
+        }
+    };
+
+    struct Run
+    {
+        std::string mode;
+        int halfPeriod, motors;
+        unsigned load;
+
+        double requestedRate, achievedRate;
+        unsigned long edges, missed;
+        double p50, p99, max;
+        unsigned long histogram[BUCKETS_COUNT];
+
+        double cpu, maxThreadCpu;
+    };
+
+    class Report
+    {
+        std::FILE *csv_;
+
+    public:
+        Report(const char *csv) : csv_(csv ? std::fopen(csv, "w") : nullptr)
+        {
+            std::printf("%-9s %6s %6s %4s %10s %10s %8s %7s %9s %9s %9s %7s %7s\n",
+                "mode", "hp_us", "motors", "load", "req_rate", "rate", "edges", "missed",
+                "p50_us", "p99_us", "max_us", "cpu%", "thr%");
+
+            if (!csv_)
+                return;
+
+            std::fprintf(csv_, "mode,half_period_us,motors,load,requested_rate,achieved_rate,edges,missed,"
+                "p50_error_us,p99_error_us,max_error_us,cpu_percent,max_thread_cpu_percent");
+
+            for (std::size_t i = 0; i < BUCKETS_COUNT - 1; i++)
+                std::fprintf(csv_, ",error_lt_%lldus", BUCKETS[i]);
+            std::fprintf(csv_, ",error_ge_%lldus\n", BUCKETS[BUCKETS_COUNT - 2]);
+        }
+
+        ~Report()
+        {
+            if (csv_)
+                std::fclose(csv_);
+        }
+
+        void add(const Run &run)
+        {
+            std::printf("%-9s %6d %6d %4u %10.1f %10.1f %8lu %7lu %9.1f %9.1f %9.1f %7.2f %7.2f\n",
+                run.mode.c_str(), run.halfPeriod, run.motors, run.load, run.requestedRate, run.achievedRate,
+                run.edges, run.missed, run.p50, run.p99, run.max, run.cpu, run.maxThreadCpu);
+
+            if (!csv_)
+                return;
+
+            std::fprintf(csv_, "%s,%d,%d,%u,%.1f,%.1f,%lu,%lu,%.2f,%.2f,%.2f,%.2f,%.2f",
+                run.mode.c_str(), run.halfPeriod, run.motors, run.load, run.requestedRate, run.achievedRate,
+                run.edges, run.missed, run.p50, run.p99, run.max, run.cpu, run.maxThreadCpu);
+
+            for (std::size_t i = 0; i < BUCKETS_COUNT; i++)
+                std::fprintf(csv_, ",%lu", run.histogram[i]);
+            std::fprintf(csv_, "\n");
+            std::fflush(csv_);
+        }
+    };
+
+    /**
+     * Calls @start, waits @seconds with @loadThreads spinning and calls @stop. Fills in @run
+     * the CPU time, as a percentage of one core, of the threads other than the main and the
+     * load ones: the motor threads. It is sampled before @stop, which may end them.
+     */
+    void measure(Run &run, int seconds, unsigned loadThreads, std::function<void()> start, std::function<void()> stop)
+    {
+        Load load(loadThreads);
+
+        std::map<int, long long> before = threadsTime();
+        long long begin = Latency::now();
+
+        start();
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+
+        std::map<int, long long> after = threadsTime();
+        double wall = Latency::now() - begin;
+
+        stop();
+
+        std::vector<int> excluded = load.tids();
+        excluded.push_back(tid());
+
+        run.cpu = run.maxThreadCpu = 0;
+
+        for (const auto &thread : after)
+        {
+            if (std::find(excluded.begin(), excluded.end(), thread.first) != excluded.end())
+                continue;
+
+            auto previous = before.find(thread.first);
+            double cpu = 100 * (thread.second - (previous == before.end() ? 0 : previous->second)) / wall;
+
+            run.cpu += cpu;
+            run.maxThreadCpu = std::max(run.maxThreadCpu, cpu);
+        }
+    }
+
+    // Interval statistics of the step edges of @motors steppers with half period @halfPeriod
+    void analyze(Run &run, const std::vector<std::vector<long long>> &edges, int halfPeriod, double wall)
+    {
+        std::vector<long long> errors;
+
+        run.edges = 0;
+        std::fill(run.histogram, run.histogram + BUCKETS_COUNT, 0);
+
+        for (const std::vector<long long> &pin : edges)
+        {
+            run.edges += pin.size();
+
+            for (std::size_t i = 1; i < pin.size(); i++)
+            {
+                long long error = std::abs(pin[i] - pin[i - 1] - halfPeriod * 1000LL);
+                errors.push_back(error);
+
+                std::size_t bucket = 0;
+                while (bucket < BUCKETS_COUNT - 1 && error >= BUCKETS[bucket] * 1000)
+                    bucket++;
+                run.histogram[bucket]++;
+            }
+        }
+
+        run.requestedRate   = 1e6 / (2 * halfPeriod);
+        run.achievedRate    = run.motors ? run.edges / 2.0 / run.motors / wall : 0;
+        run.p50 = run.p99 = run.max = 0;
+
+        if (errors.empty())
+            return;
+
+        std::sort(errors.begin(), errors.end());
+        run.p50 = errors[errors.size() / 2] / 1e3;
+        run.p99 = errors[std::min(errors.size() - 1, errors.size() * 99 / 100)] / 1e3;
+        run.max = errors.back() / 1e3;
+    }
+
+    void runSteppers(Report &report, const std::string &mode, int halfPeriod, int motors, unsigned load, int seconds)
+    {
+        Controller controller;
+        controller.setup();
+
+        std::vector<std::vector<long long>> edges(motors);
+        for (std::vector<long long> &pin : edges)
+            pin.reserve(static_cast<std::size_t>(seconds * 2e6 / halfPeriod) + 16);
+
+        controller.setObserver([&](const Controller::Event &event) {
+            int motor = (event.pin - FIRST_PIN) / 3;
+
+            // Step pins only
+            if (event.type == Controller::Event::Type::LEVEL && event.pin >= FIRST_PIN && motor < motors && (event.pin - FIRST_PIN) % 3 == 2)
+                edges[motor].push_back(event.timestamp);
+        });
+
+        std::vector<std::unique_ptr<Stepper>> steppers;
+        for (int i = 0; i < motors; i++)
+        {
+            int pin = FIRST_PIN + 3 * i;
+
+            steppers.emplace_back(new Stepper(&controller, pin, pin + 1, pin + 2));
+            steppers.back()->setup();
+            steppers.back()->setDirection(Direction::CW);
+            steppers.back()->setVelocity(halfPeriod);
+        }
+
+        MotionScheduler motion;
+        if (mode == "scheduler")
+        {
+            for (auto &stepper : steppers)
+                motion.add(*stepper);
+            motion.startScheduling();
+        }
+
+        Run run = {};
+        run.mode        = mode;
+        run.halfPeriod  = halfPeriod;
+        run.motors      = motors;
+        run.load        = load;
+
+        // step() blocks, so it is called in a loop by a thread of its own
+        std::atomic<bool> isStepping(false);
+        std::thread *stepping = nullptr;
+
+        long long start = Latency::now();
+
+        measure(run, seconds, load, [&]() {
+            if (mode == "step")
+            {
+                isStepping = true;
+                stepping = new std::thread([&]() {
+                    Realtime::apply(Realtime::MOTION);
+
+                    while (isStepping)
+                        steppers[0]->step();
+                });
+                return;
+            }
+
+            for (auto &stepper : steppers)
+                stepper->startStepping();
+        }, [&]() {
+            if (mode == "step")
+            {
+                isStepping = false;
+                stepping->join();
+                delete stepping;
+                return;
+            }
+
+            for (auto &stepper : steppers)
+                stepper->stopStepping();
+        });
+
+        double wall = (Latency::now() - start) / 1e9;
+
+        motion.stopScheduling();
+        controller.setObserver(nullptr);
+
+        run.missed = 0;
+        for (auto &stepper : steppers)
+            run.missed += stepper->missedEdges();
+
+        analyze(run, edges, halfPeriod, wall);
+        report.add(run);
+    }
+
+    void runDCMotor(Report &report, unsigned load, int seconds)
+    {
+        Controller controller;
+        controller.setup();
+
+        DCMotor motor(&controller, FIRST_PIN, FIRST_PIN + 1, DCMotor::PWM_MIN, DCMotor::PWM_MAX);
+        motor.setup();
+        motor.setDirection(Direction::CW);
+        motor.setVelocity(DCMotor::PWM_MIN);
+
+        Run run = {};
+        run.mode    = "dcmotor";
+        run.load    = load;
+
+        // Velocity updates at the rate of the joystick
+        std::atomic<bool> isUpdating(false);
+        std::thread *updates = nullptr;
+
+        measure(run, seconds, load, [&]() {
+            motor.startPwm();
+
+            isUpdating = true;
+            updates = new std::thread([&]() {
+                for (int velocity = 0; isUpdating; velocity++)
+                {
+                    motor.setVelocity(DCMotor::PWM_MIN + velocity % (DCMotor::PWM_MAX - DCMotor::PWM_MIN + 1));
+                    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                }
+            });
+        }, [&]() {
+            isUpdating = false;
+            updates->join();
+            delete updates;
+
+            motor.stopPwm();
+        });
+
+        report.add(run);
+    }
+
+    void printStarts(const char *motor, std::vector<long long> &latencies)
+    {
+        std::sort(latencies.begin(), latencies.end());
+
+        std::printf("%-9s %8zu %9.1f %9.1f %9.1f\n", motor, latencies.size(),
+            latencies[latencies.size() / 2] / 1e3,
+            latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)] / 1e3,
+            latencies.back() / 1e3);
+    }
+
+    /**
+     * Starts and stops a stepper and a DCMotor @cycles times, timing each start up to
+     * the first write on the step or PWM pin, which is taken by the motor thread.
+     */
+    void runStarts(int cycles)
+    {
+        Controller controller;
+        controller.setup();
+
+        std::atomic<long long> firstWrite(0);
+        controller.setObserver([&](const Controller::Event &event) {
+            bool isStep = event.type == Controller::Event::Type::LEVEL && event.pin == FIRST_PIN + 2;
+            bool isPwm  = event.type == Controller::Event::Type::PWM && event.pin == FIRST_PIN + 4 && event.value > 0;
+
+            long long none = 0;
+            if (isStep || isPwm)
+                firstWrite.compare_exchange_strong(none, event.timestamp);
+        });
+
+        auto time = [&](std::function<void()> start) {
+            firstWrite = 0;
+
+            long long begin = Latency::now();
+            start();
+
+            while (firstWrite == 0)
+                std::this_thread::yield();
+
+            return firstWrite - begin;
+        };
+
+        Stepper stepper(&controller, FIRST_PIN, FIRST_PIN + 1, FIRST_PIN + 2);
+        stepper.setup();
+        stepper.setDirection(Direction::CW);
+        stepper.setVelocity(100);
+
+        DCMotor motor(&controller, FIRST_PIN + 3, FIRST_PIN + 4, DCMotor::PWM_MIN, DCMotor::PWM_MAX);
+        motor.setup();
+        motor.setDirection(Direction::CW);
+        motor.setVelocity(DCMotor::PWM_MAX);
+
+        std::vector<long long> steps, pwms;
+        steps.reserve(cycles);
+        pwms.reserve(cycles);
+
+        for (int i = 0; i < cycles; i++)
+        {
+            steps.push_back(time([&]() { stepper.startStepping(); }));
+            stepper.stopStepping();
+
+            pwms.push_back(time([&]() { motor.startPwm(); }));
+            motor.stopPwm();
+
+            // Lets the stepper thread see the stop at its next edge
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        controller.setObserver(nullptr);
+
+        std::printf("\n%-9s %8s %9s %9s %9s\n", "start", "cycles", "p50_us", "p99_us", "max_us");
+        printStarts("stepper", steps);
+        printStarts("dcmotor", pwms);
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    int seconds     = argc > 1 ? std::atoi(argv[1]) : 1;
+    const char *csv = argc > 2 ? argv[2] : nullptr;
+    int cycles      = argc > 3 ? std::atoi(argv[3]) : 2000;
+
+    const int halfPeriods[] = { 1000, 500, 250, 100 };
+    const unsigned loads[]  = { 0, std::max(1u, std::thread::hardware_concurrency()) };
+
+    std::string rtError;
+    if (!Realtime::configure(Realtime::fromEnvironment(), rtError))
+        std::fprintf(stderr, "Real-time profile disabled. %s\n", rtError.c_str());
+
+    Report report(csv);
+
+    for (unsigned load : loads)
+    {
+        for (int halfPeriod : halfPeriods)
+        {
+            runSteppers(report, "step", halfPeriod, 1, load, seconds);
+
+            for (int motors : { 1, MAX_MOTORS })
+            {
+                runSteppers(report, "thread", halfPeriod, motors, load, seconds);
+                runSteppers(report, "scheduler", halfPeriod, motors, load, seconds);
+            }
+        }
+
+        runDCMotor(report, load, seconds);
+    }
+
+    if (cycles > 0)
+        runStarts(cycles);
+
+    return 0;
+}
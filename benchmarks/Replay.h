@@ -0,0 +1,113 @@
+/**
+ * Helpers for the replays of the control traffic captures, see Capture.h.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Capture.h"
+
+namespace Replay
+{
+    using Politocean::Capture::Kind;
+    using Politocean::Capture::Reader;
+    using Politocean::Capture::Record;
+
+    /**
+     * Delivers the MESSAGE records of @reader, at @speed times the captured pace,
+     * or back to back if @speed is 0. Other records are skipped.
+     * Returns the number of messages delivered.
+     */
+    inline unsigned long run(Reader& reader, double speed, std::function<void(const Record&)> deliver)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        unsigned long messages = 0;
+        Record record;
+
+        while (reader.next(record))
+        {
+            if (record.kind != Kind::MESSAGE)
+                continue;
+
+            if (speed > 0)
+                std::this_thread::sleep_until(start + std::chrono::nanoseconds(static_cast<long long>(record.timestamp / speed)));
+
+            deliver(record);
+            messages++;
+        }
+
+        return messages;
+    }
+
+    // Data of the output records of a capture, in order, for each kind and channel
+    typedef std::map<std::pair<int, unsigned>, std::vector<std::string>> Outputs;
+
+    inline bool load(const std::string& path, Outputs& outputs)
+    {
+        Reader reader;
+        if (!reader.open(path))
+            return false;
+
+        Record record;
+
+        while (reader.next(record))
+            if (record.kind != Kind::MESSAGE)
+                outputs[{ static_cast<int>(record.kind), record.channel }].push_back(record.data);
+
+        return true;
+    }
+
+    /**
+     * Compares the outputs of @candidate with the ones of @reference, channel by channel,
+     * regardless of their timing. Prints the records of each channel and the first one that
+     * differs, and returns whether they are all the same.
+     */
+    inline bool diff(const std::string& reference, const std::string& candidate)
+    {
+        const char *kinds[] = { "topic", "message", "spi", "level", "pwm" };
+        Outputs expected, actual;
+
+        if (!load(reference, expected) || !load(candidate, actual))
+        {
+            std::fprintf(stderr, "Can't read %s or %s\n", reference.c_str(), candidate.c_str());
+            return false;
+        }
+
+        for (const auto& channel : actual)
+            expected[channel.first];
+
+        bool isSame = true;
+
+        std::printf("%-6s %7s %10s %10s %10s\n", "kind", "channel", "reference", "candidate", "first_diff");
+
+        for (const auto& channel : expected)
+        {
+            const std::vector<std::string>& a = channel.second;
+            const std::vector<std::string>& b = actual[channel.first];
+
+            std::size_t first = std::mismatch(a.begin(), a.begin() + std::min(a.size(), b.size()), b.begin()).first - a.begin();
+            bool isChannelSame = first == a.size() && a.size() == b.size();
+
+            if (isChannelSame)
+                std::printf("%-6s %7u %10zu %10zu %10s\n", kinds[channel.first.first], channel.first.second, a.size(), b.size(), "-");
+            else
+                std::printf("%-6s %7u %10zu %10zu %10zu\n", kinds[channel.first.first], channel.first.second, a.size(), b.size(), first);
+
+            isSame = isSame && isChannelSame;
+        }
+
+        return isSame;
+    }
+}
+
+#endif // REPLAY_H
@@ -0,0 +1,168 @@
+/**
+ * End-to-end latency of the wrist control path, on the simulated Controller.
+ *
+ * Publishes WRIST START and STOP through an in-process broker, to the same
+ * Listener and Arm classes of PolitoceanSkeleton, and measures the time from
+ * each START to the first step pulse edge of the wrist.
+ *
+ * Usage: SkeletonLatencyBenchmark [messages]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "Arm.h"
+
+#include "Latency.h"
+
+namespace
+{
+    const std::chrono::milliseconds TIMEOUT(1000);
+
+    // Time without step edges after which the wrist is considered stopped
+    const long long QUIET = 100 * 1000000LL;
+
+    // Timestamps of the step edges of one pin
+    class EdgeWatcher
+    {
+        int pin_;
+        long long since_, first_, last_;
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+
+    public:
+        EdgeWatcher(int pin) : pin_(pin), since_(LLONG_MAX), first_(0), last_(0) {}
+
+        void observe(const Controller::Event& event)
+        {
+            if (event.type != Controller::Event::Type::LEVEL || event.pin != pin_)
+                return;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            last_ = event.timestamp;
+
+            if (first_ == 0 && event.timestamp >= since_)
+            {
+                first_ = event.timestamp;
+                cv_.notify_one();
+            }
+        }
+
+        // Looks for the first edge from @since on
+        void arm(long long since)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            since_ = since;
+            first_ = 0;
+        }
+
+        // Returns the timestamp of the first edge since arm(), 0 on timeout
+        long long wait(std::chrono::milliseconds timeout)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            cv_.wait_for(lock, timeout, [this]() { return first_ != 0; });
+
+            long long first = first_;
+            since_ = LLONG_MAX;
+
+            return first;
+        }
+
+        // Waits until no edges have been seen for @quiet nanoseconds
+        void settle(long long quiet)
+        {
+            for (;;)
+            {
+                long long last;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    last = last_;
+                }
+
+                long long idle = Latency::now() - last;
+                if (idle >= quiet)
+                    return;
+
+                std::this_thread::sleep_for(std::chrono::nanoseconds(quiet - idle));
+            }
+        }
+    };
+}
+
+int main(int argc, const char *argv[])
+{
+    int messages = argc > 1 ? std::atoi(argv[1]) : 50;
+
+    Controller controller;
+    controller.setup();
+
+    Listener listener;
+    Arm arm(controller);
+    arm.setup();
+
+    EdgeWatcher watcher(Pinout::WRIST_STEP);
+    controller.setObserver([&](const Controller::Event& event) { watcher.observe(event); });
+
+    Latency::Broker broker;
+
+    Latency::Broker::Callback wrist = [&](const std::string& payload, const std::string& topic) {
+        listener.listenForWrist(payload, topic);
+    };
+    broker.subscribe(Topics::WRIST, wrist);
+    broker.subscribe(Topics::WRIST_VELOCITY, wrist);
+
+    // Dispatcher, as in PolitoceanSkeleton
+    std::atomic<bool> isRunning(true);
+    std::thread dispatcher([&]() {
+        Action next;
+
+        while (isRunning)
+            if (listener.waitForAction(next, std::chrono::milliseconds(100)))
+                arm.dispatch(next);
+    });
+
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> velocity(1, SHRT_MAX);
+    std::uniform_int_distribution<int> pause(0, 20);
+
+    Latency::Samples startLatency;
+
+    for (int i = 0; i < messages; i++)
+    {
+        broker.publish(Topics::WRIST_VELOCITY, std::to_string(i % 2 ? velocity(random) : -velocity(random)));
+        std::this_thread::sleep_for(std::chrono::milliseconds(pause(random)));
+
+        long long sent = Latency::now();
+        watcher.arm(sent);
+        broker.publish(Topics::WRIST, Commands::Actions::START);
+
+        long long found = watcher.wait(TIMEOUT);
+        if (found)
+            startLatency.add(found - sent);
+        else
+            startLatency.timeout();
+
+        broker.publish(Topics::WRIST, Commands::Actions::STOP);
+        watcher.settle(QUIET);
+    }
+
+    isRunning = false;
+    dispatcher.join();
+
+    controller.setObserver(nullptr);
+
+    startLatency.report("wrist");
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+/**
+ * Replay of a PolitoceanSkeleton capture, on the simulated Controller.
+ *
+ * Delivers the messages of @capture, recorded with POLITOCEAN_CAPTURE, to the
+ * same Listener and Arm classes of PolitoceanSkeleton, @speed times faster than
+ * they were received, or back to back with a @speed of 0.
+ * The pins written are recorded into @output, on the time base of @capture, and
+ * compared with the ones of @reference if given, e.g. the output of the replay
+ * of the same capture before a change.
+ * At other speeds only the outputs independent of the timing match: the joints
+ * started and stopped by the messages step for as long as they are left running,
+ * and a move is cut short by the next message of its joint if it is still running.
+ *
+ * Usage: SkeletonReplay capture [speed] [output] [reference]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "Arm.h"
+
+#include "Replay.h"
+
+namespace
+{
+    // Time left to the motors to complete the last moves
+    const std::chrono::milliseconds DRAIN(2000);
+
+    bool isInFamily(const std::string& topic, const std::string& family)
+    {
+        return topic.compare(0, family.size(), family) == 0;
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "Usage: %s capture [speed] [output] [reference]\n", argv[0]);
+        return 1;
+    }
+
+    double speed        = argc > 2 ? std::atof(argv[2]) : 1;
+    std::string output  = argc > 3 ? argv[3] : "skeleton-replay.ptoc";
+
+    Capture::Reader reader;
+    if (!reader.open(argv[1]))
+    {
+        std::fprintf(stderr, "%s is not a capture\n", argv[1]);
+        return 1;
+    }
+
+    Capture::Recorder recorder;
+    if (!recorder.open(output))
+    {
+        std::fprintf(stderr, "Can't create %s\n", output.c_str());
+        return 1;
+    }
+    recorder.setSpeed(speed);
+
+    Controller controller;
+    controller.setup();
+
+    controller.setObserver([&](const Controller::Event& event) {
+        if (event.type == Controller::Event::Type::LEVEL)
+        {
+            unsigned char level = event.value;
+            recorder.output(Capture::Kind::LEVEL, event.pin, &level, sizeof(level));
+        }
+        else if (event.type == Controller::Event::Type::PWM)
+        {
+            std::uint32_t value = event.value;
+            recorder.output(Capture::Kind::PWM, event.pin, &value, sizeof(value));
+        }
+    });
+
+    Listener listener;
+    Arm arm(controller);
+    arm.setup();
+
+    // Dispatcher, as in PolitoceanSkeleton
+    std::atomic<bool> isRunning(true);
+    std::thread dispatcher([&]() {
+        Action next;
+
+        while (isRunning)
+            if (listener.waitForAction(next, std::chrono::milliseconds(100)))
+                arm.dispatch(next);
+    });
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    unsigned long long captured = 0;
+
+    // The replay thread stands for the MQTT one, routing the topics as subscribeToFamily()
+    unsigned long messages = Replay::run(reader, speed, [&](const Capture::Record& record) {
+        captured = record.timestamp;
+
+        if (isInFamily(record.topic, Topics::SHOULDER))
+            listener.listenForShoulder(record.data, record.topic);
+        else if (isInFamily(record.topic, Topics::WRIST))
+            listener.listenForWrist(record.data, record.topic);
+        else if (isInFamily(record.topic, Topics::HAND))
+            listener.listenForHand(record.data, record.topic);
+        else if (isInFamily(record.topic, Topics::HEAD))
+            listener.listenForHead(record.data, record.topic);
+    });
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::this_thread::sleep_for(DRAIN);
+
+    isRunning = false;
+    dispatcher.join();
+
+    controller.setObserver(nullptr);
+    recorder.close();
+
+    std::printf("%lu messages, %.3f s captured in %.3f s, %lu records dropped\n",
+        messages, captured / 1e9, elapsed.count(), recorder.dropped());
+
+    if (argc > 4 && !Replay::diff(argv[4], output))
+        return 2;
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#ifndef AXES_PAYLOAD_H
+#define AXES_PAYLOAD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Commands.h"
+
+namespace Politocean {
+
+/**
+ * Fixed layout binary encoding of the joystick axes, published on Topics::AXES_BINARY.
+ * All the fields are little endian:
+ *  (*) MAGIC
+ *  (*) VERSION
+ *  (*) sequence number, 32 bit unsigned, incremented by the publisher for every payload
+ *  (*) one 16 bit signed value for each axis, in Commands::ATMega::Axes order
+ * Payloads with a different magic, version or size are rejected as a whole.
+ */
+namespace AxesPayload {
+
+    const unsigned char MAGIC   = 0xA5;
+    const unsigned char VERSION = 1;
+
+    const std::size_t HEADER    = 6;
+    const std::size_t SIZE      = HEADER + 2 * Constants::Commands::ATMega::Axes::COUNT;
+
+    struct Axes
+    {
+        std::uint32_t sequence;
+        int values[Constants::Commands::ATMega::Axes::COUNT];
+    };
+
+    // Decodes @payload into @axes without allocating, returns false if it is not a valid payload
+    inline bool decode(const std::string &payload, Axes &axes)
+    {
+        if (payload.size() != SIZE)
+            return false;
+
+        const unsigned char *data = reinterpret_cast<const unsigned char *>(payload.data());
+
+        if (data[0] != MAGIC || data[1] != VERSION)
+            return false;
+
+        axes.sequence = static_cast<std::uint32_t>(data[2]) | static_cast<std::uint32_t>(data[3]) << 8 |
+                        static_cast<std::uint32_t>(data[4]) << 16 | static_cast<std::uint32_t>(data[5]) << 24;
+
+        for (std::size_t i = 0; i < Constants::Commands::ATMega::Axes::COUNT; i++)
+            axes.values[i] = static_cast<std::int16_t>(data[HEADER + 2 * i] | data[HEADER + 2 * i + 1] << 8);
+
+        return true;
+    }
+
+    // Axes values are clamped to the 16 bit range
+    inline std::string encode(const Axes &axes)
+    {
+        std::string payload(SIZE, '\0');
+
+        payload[0] = static_cast<char>(MAGIC);
+        payload[1] = static_cast<char>(VERSION);
+
+        for (std::size_t i = 0; i < 4; i++)
+            payload[2 + i] = static_cast<char>(axes.sequence >> (8 * i));
+
+        for (std::size_t i = 0; i < Constants::Commands::ATMega::Axes::COUNT; i++)
+        {
+            int value = axes.values[i] < INT16_MIN ? INT16_MIN : axes.values[i] > INT16_MAX ? INT16_MAX : axes.values[i];
+            std::uint16_t bits = static_cast<std::uint16_t>(static_cast<std::int16_t>(value));
+
+            payload[HEADER + 2 * i]     = static_cast<char>(bits & 0xFF);
+            payload[HEADER + 2 * i + 1] = static_cast<char>(bits >> 8);
+        }
+
+        return payload;
+    }
+
+} // namespace AxesPayload
+
+} // namespace Politocean
+
+#endif // AXES_PAYLOAD_H
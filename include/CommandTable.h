@@ -0,0 +1,48 @@
+#ifndef COMMAND_TABLE_H
+#define COMMAND_TABLE_H
+
+#include <algorithm>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Politocean {
+
+/**
+ * Maps the text of a command received over MQTT to its numeric identifier.
+ * The entries are sorted once when the table is built, so lookups are a
+ * binary search that neither allocates nor copies the payload.
+ */
+template <typename Id>
+class CommandTable
+{
+    typedef std::pair<std::string, Id> Entry;
+
+    std::vector<Entry> entries_;
+    Id none_;
+
+    static bool less(const Entry &entry, const std::string &text) { return entry.first < text; }
+
+public:
+    // @none is returned for any text that is not in @entries
+    CommandTable(std::initializer_list<Entry> entries, Id none) : entries_(entries), none_(none)
+    {
+        std::sort(entries_.begin(), entries_.end(),
+            [](const Entry &a, const Entry &b) { return a.first < b.first; });
+    }
+
+    Id find(const std::string &text) const
+    {
+        typename std::vector<Entry>::const_iterator it = std::lower_bound(entries_.begin(), entries_.end(), text, less);
+
+        if (it == entries_.end() || it->first != text)
+            return none_;
+
+        return it->second;
+    }
+};
+
+}
+
+#endif // COMMAND_TABLE_H
@@ -5,6 +5,8 @@
 #ifndef COMMANDS_H
 #define COMMANDS_H
 
+#include <string>
+
 using namespace std;
 
 namespace Politocean {
@@ -19,8 +21,35 @@ namespace Commands {
             const short Y_AXIS      = 1;
             const short RZ_AXIS     = 2;
             const short PITCH_AXIS  = 3;
+
+            const short COUNT       = 4;
         }
 
+        /**
+         * Commands received on Topics::COMMANDS.
+         * Only the ones after OFF are forwarded to the ATMega.
+         */
+        enum class Command : unsigned char
+        {
+            NONE,
+            RESET,
+            ON,
+            OFF,
+            VDOWN_ON,
+            VDOWN_OFF,
+            VUP_ON,
+            VUP_OFF,
+            FAST,
+            SLOW,
+            MEDIUM,
+            START_AND_STOP,
+            VUP_FAST_ON,
+            VUP_FAST_OFF,
+            PITCH_CONTROL,
+
+            COUNT
+        };
+
         namespace SPI
         {
             const unsigned char VDOWN_ON           = 0x04;
@@ -35,6 +64,18 @@ namespace Commands {
             const unsigned char VUP_FAST_OFF       = 0x14;
             const unsigned char PITCH_CONTROL      = 0x15;
 
+            // SPI code of each Command, 0 for the ones handled by the Raspberry
+            const unsigned char CODES[static_cast<int>(Command::COUNT)] = {
+                0, 0, 0, 0,
+                VDOWN_ON, VDOWN_OFF, VUP_ON, VUP_OFF,
+                FAST, SLOW, MEDIUM, START_AND_STOP,
+                VUP_FAST_ON, VUP_FAST_OFF, PITCH_CONTROL
+            };
+
+            /**
+             * AXES and COMMAND start the frames sent to the ATMega,
+             * SENSORS starts the sensors frames it sends back (see SensorsDecoder).
+             */
             namespace Delims
             {
                 const unsigned char AXES         = 0xFF;
@@ -46,29 +87,60 @@ namespace Commands {
 
     namespace Skeleton
     {
-        const string SHOULDER_ON    = "SHOULDER_ON";
-        const string SHOULDER_OFF   = "SHOULDER_OFF";
-        const string SHOULDER_UP    = "SHOULDER_UP";
-        const string SHOULDER_DOWN  = "SHOULDER_DOWN";
-        const string SHOULDER_STEP  = "SHOULDER_STEP";
-        const string SHOULDER_STOP  = "SHOULDER_STOP";
-
-        const string WRIST_ON       = "WRIST_ON";
-        const string WRIST_OFF      = "WRIST_OFF";
-        const string WRIST_START    = "WRIST_START";
-        const string WRIST_STOP     = "WRIST_STOP";
-        
-        const string HAND_START     = "HAND_START";
-        const string HAND_STOP      = "HAND_STOP";
-
-        const string HEAD_ON        = "HEAD_ON";
-        const string HEAD_OFF       = "HEAD_OFF";
-        const string HEAD_UP        = "HEAD_UP";
-        const string HEAD_DOWN      = "HEAD_DOWN";
-        const string HEAD_STEP      = "HEAD_STEP";
-        const string HEAD_STOP      = "HEAD_STOP";
-
-        const string NONE           = "NONE";
+        // Payloads received on the Skeleton topics
+        enum class Payload : unsigned char
+        {
+            NONE,
+            ON,
+            OFF,
+            START,
+            STOP,
+            UP,
+            DOWN
+        };
+
+        // Actions queued for the Skeleton dispatcher
+        enum Action : unsigned char
+        {
+            NONE,
+
+            SHOULDER_ON,
+            SHOULDER_OFF,
+            SHOULDER_UP,
+            SHOULDER_DOWN,
+            SHOULDER_STEP,
+            SHOULDER_STOP,
+            SHOULDER_MOVE_TO,
+            SHOULDER_MOVE_BY,
+
+            WRIST_ON,
+            WRIST_OFF,
+            WRIST_START,
+            WRIST_STOP,
+            WRIST_VELOCITY,
+
+            HAND_START,
+            HAND_STOP,
+
+            HEAD_ON,
+            HEAD_OFF,
+            HEAD_UP,
+            HEAD_DOWN,
+            HEAD_STEP,
+            HEAD_STOP,
+            HEAD_MOVE_TO,
+            HEAD_MOVE_BY,
+
+            ARM_REACH_TO,
+            ARM_REACH_BY
+        };
+
+        // Modes of the move and reach payloads (see Topics::SHOULDER_MOVE and Topics::SHOULDER_REACH)
+        namespace Move
+        {
+            const std::string TO    = "TO";
+            const std::string BY    = "BY";
+        }
     }
 
 }
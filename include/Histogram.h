@@ -0,0 +1,140 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+namespace Politocean {
+
+/**
+ * Always-on latency histogram with logarithmic buckets.
+ * Bucket 0 counts the samples under 1 us, bucket i the ones in [2^(i-1), 2^i) us,
+ * and the last bucket everything longer.
+ * record() never locks nor allocates. Each histogram is meant to be recorded by a
+ * single thread, so its counters are never contended, while any thread can take
+ * snapshots of it.
+ */
+class Histogram
+{
+public:
+    static const std::size_t BUCKETS = 32;
+
+    /**
+     * Counts of a histogram at some point in time.
+     * The difference of two snapshots gives the samples recorded in between.
+     * @sum is in nanoseconds, @max is the longest sample since the previous take().
+     */
+    struct Snapshot
+    {
+        unsigned long long buckets[BUCKETS];
+        unsigned long long count, sum;
+        long long max;
+
+        // Upper bound in microseconds of the bucket holding the @quantile
+        unsigned long long percentile(double quantile) const
+        {
+            unsigned long long rank = static_cast<unsigned long long>(quantile * count), seen = 0;
+
+            for (std::size_t i = 0; i < BUCKETS; i++)
+            {
+                seen += buckets[i];
+                if (seen > rank)
+                    return 1ULL << i;
+            }
+
+            return 1ULL << (BUCKETS - 1);
+        }
+
+        // Mean in microseconds
+        unsigned long long mean() const
+        {
+            return count ? sum / count / 1000 : 0;
+        }
+
+        Snapshot operator-(const Snapshot &previous) const
+        {
+            Snapshot difference = *this;
+
+            for (std::size_t i = 0; i < BUCKETS; i++)
+                difference.buckets[i] -= previous.buckets[i];
+            difference.count -= previous.count;
+            difference.sum -= previous.sum;
+
+            return difference;
+        }
+    };
+
+    // Records the time from its construction to its destruction
+    class Timer
+    {
+        Histogram &histogram_;
+        std::chrono::steady_clock::time_point start_;
+
+    public:
+        explicit Timer(Histogram &histogram) : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+        ~Timer() { histogram_.record(std::chrono::steady_clock::now() - start_); }
+
+        Timer(const Timer &) = delete;
+        Timer &operator=(const Timer &) = delete;
+    };
+
+private:
+    std::atomic<unsigned long long> buckets_[BUCKETS];
+    std::atomic<unsigned long long> count_, sum_;
+    std::atomic<long long> max_;
+
+public:
+    Histogram() : count_(0), sum_(0), max_(0)
+    {
+        for (std::size_t i = 0; i < BUCKETS; i++)
+            buckets_[i].store(0, std::memory_order_relaxed);
+    }
+
+    Histogram(const Histogram &) = delete;
+    Histogram &operator=(const Histogram &) = delete;
+
+    void record(std::chrono::nanoseconds elapsed)
+    {
+        long long ns = std::max<long long>(elapsed.count(), 0);
+        unsigned long long us = ns / 1000;
+
+        std::size_t bucket = us ? std::min<std::size_t>(64 - __builtin_clzll(us), BUCKETS - 1) : 0;
+
+        buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(ns, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_release);
+
+        long long max = max_.load(std::memory_order_relaxed);
+        while (ns > max && !max_.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+            ;
+    }
+
+    Snapshot snapshot() const
+    {
+        Snapshot snapshot;
+
+        // The count is read first, so it never exceeds the sum of the buckets
+        snapshot.count = count_.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < BUCKETS; i++)
+            snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        snapshot.sum = sum_.load(std::memory_order_relaxed);
+        snapshot.max = max_.load(std::memory_order_relaxed);
+
+        return snapshot;
+    }
+
+    // Like snapshot(), but also restarts the max from zero
+    Snapshot take()
+    {
+        Snapshot snapshot = this->snapshot();
+        snapshot.max = max_.exchange(0, std::memory_order_relaxed);
+
+        return snapshot;
+    }
+};
+
+} // namespace Politocean
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,67 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+
+namespace Politocean {
+
+/**
+ * Bounded lock-free queue for exactly one producer thread and one consumer thread.
+ * All the @N slots are allocated with the queue, so push() and pop() never
+ * allocate nor block. @N must be a power of two.
+ */
+template <typename T, std::size_t N>
+class RingBuffer
+{
+    static_assert(N > 1 && (N & (N - 1)) == 0, "RingBuffer size must be a power of two");
+
+    T buffer_[N];
+
+    // @head_ is only written by the consumer, @tail_ only by the producer
+    alignas(64) std::atomic<std::size_t> head_;
+    alignas(64) std::atomic<std::size_t> tail_;
+
+public:
+    RingBuffer() : head_(0), tail_(0) {}
+
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer &operator=(const RingBuffer &) = delete;
+
+    // Returns false if the queue is full
+    bool push(const T &item)
+    {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+
+        if (tail - head_.load(std::memory_order_acquire) == N)
+            return false;
+
+        buffer_[tail & (N - 1)] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Returns false if the queue is empty
+    bool pop(T &item)
+    {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+
+        item = buffer_[head & (N - 1)];
+        head_.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+};
+
+}
+
+#endif // RING_BUFFER_H
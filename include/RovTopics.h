@@ -0,0 +1,39 @@
+#ifndef ROV_TOPICS_H
+#define ROV_TOPICS_H
+
+#include <string>
+
+namespace Politocean {
+namespace Constants {
+namespace Topics {
+
+    // Joystick axes in the AxesPayload binary encoding, an alternative to the JSON ones on AXES
+    const std::string AXES_BINARY   = "axes/binary/";
+
+    /**
+     * Position moves of the steppers, executed entirely on the ROV.
+     * The payload is Commands::Skeleton::Move::TO or BY followed by a number of steps,
+     * e.g. "TO 1200" or "BY -300".
+     */
+    const std::string SHOULDER_MOVE = "shoulder/move/";
+    const std::string HEAD_MOVE     = "head/move/";
+
+    /**
+     * Coordinated move of the shoulder and the wrist, which start and end together.
+     * The payload is a mode as for the moves, followed by the shoulder and the wrist steps,
+     * e.g. "TO 1200 -400".
+     */
+    const std::string SHOULDER_REACH = "shoulder/reach/";
+
+    // Timing summaries published by Diagnostics
+    namespace Diagnostics
+    {
+        const std::string ATMEGA    = "diagnostics/atmega/";
+        const std::string SKELETON  = "diagnostics/skeleton/";
+    }
+
+}
+}
+}
+
+#endif // ROV_TOPICS_H
@@ -0,0 +1,78 @@
+#ifndef SEQ_LOCK_H
+#define SEQ_LOCK_H
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+namespace Politocean {
+
+/**
+ * Single-writer sequence lock.
+ * The writer never waits; readers retry until they copy a value that was not
+ * being written in the meantime, so they always get a consistent snapshot
+ * without taking a lock. @T must be trivially copyable.
+ */
+template <typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock value must be trivially copyable");
+
+    std::atomic<unsigned> seq_;
+    T value_;
+
+public:
+    SeqLock() : seq_(0), value_() {}
+    explicit SeqLock(const T &value) : seq_(0), value_(value) {}
+
+    SeqLock(const SeqLock &) = delete;
+    SeqLock &operator=(const SeqLock &) = delete;
+
+    void store(const T &value)
+    {
+        unsigned seq = seq_.load(std::memory_order_relaxed);
+
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        std::memcpy(&value_, &value, sizeof(T));
+
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const
+    {
+        unsigned version;
+        return load(version);
+    }
+
+    // Also returns in @version the version() of the value returned
+    T load(unsigned &version) const
+    {
+        T value;
+        unsigned before, after;
+
+        do
+        {
+            before = seq_.load(std::memory_order_acquire);
+
+            std::memcpy(&value, &value_, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            after = seq_.load(std::memory_order_relaxed);
+        } while (before != after || (before & 1));
+
+        version = before / 2;
+        return value;
+    }
+
+    // Number of values stored so far
+    unsigned version() const
+    {
+        return seq_.load(std::memory_order_acquire) / 2;
+    }
+};
+
+}
+
+#endif // SEQ_LOCK_H
@@ -0,0 +1,248 @@
+#include "Capture.h"
+
+#include <cstring>
+#include <ctime>
+
+using namespace Politocean::Capture;
+
+namespace
+{
+    void put(std::string &buffer, unsigned long long value, std::size_t bytes)
+    {
+        for (std::size_t i = 0; i < bytes; i++)
+            buffer.push_back(static_cast<char>(value >> (8 * i)));
+    }
+
+    unsigned long long get(const unsigned char *data, std::size_t bytes)
+    {
+        unsigned long long value = 0;
+
+        for (std::size_t i = 0; i < bytes; i++)
+            value |= static_cast<unsigned long long>(data[i]) << (8 * i);
+
+        return value;
+    }
+}
+
+std::string Politocean::Capture::path(const std::string& directory, const std::string& name)
+{
+    std::time_t now = std::time(nullptr);
+    std::tm local;
+    localtime_r(&now, &local);
+
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+
+    return directory + "/" + name + "-" + stamp + ".ptoc";
+}
+
+Recorder::~Recorder()
+{
+    close();
+}
+
+bool Recorder::open(const std::string& path)
+{
+    if (isRecording_)
+        return false;
+
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_)
+        return false;
+
+    std::string header(MAGIC, sizeof(MAGIC));
+    header.push_back(static_cast<char>(VERSION));
+    header.resize(HEADER, '\0');
+
+    std::fwrite(header.data(), 1, header.size(), file_);
+
+    topics_.clear();
+    buffer_.reserve(MAX_BUFFER);
+    dropped_ = 0;
+
+    start_          = std::chrono::steady_clock::now();
+    isRecording_    = true;
+
+    th_ = new std::thread([this]() {
+        std::string writing;
+        writing.reserve(MAX_BUFFER);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        while (isRecording_ || !buffer_.empty())
+        {
+            if (isRecording_)
+                cv_.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL), [this]() { return !isRecording_; });
+
+            writing.swap(buffer_);
+            lock.unlock();
+
+            if (!writing.empty())
+            {
+                std::fwrite(writing.data(), 1, writing.size(), file_);
+                std::fflush(file_);
+                writing.clear();
+            }
+
+            lock.lock();
+        }
+    });
+
+    return true;
+}
+
+void Recorder::close()
+{
+    if (!th_)
+        return ;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isRecording_ = false;
+        cv_.notify_one();
+    }
+
+    th_->join();
+    delete th_;
+    th_ = nullptr;
+
+    std::fclose(file_);
+    file_ = nullptr;
+}
+
+void Recorder::setSpeed(double speed)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    speed_ = speed > 0 ? speed : 1;
+}
+
+unsigned long long Recorder::now()
+{
+    std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start_;
+
+    return static_cast<unsigned long long>(elapsed.count() * speed_);
+}
+
+void Recorder::append(Kind kind, unsigned channel, unsigned long long timestamp, const void *data, std::size_t length)
+{
+    if (buffer_.size() + RECORD_HEADER + length > MAX_BUFFER)
+    {
+        dropped_++;
+        return ;
+    }
+
+    buffer_.push_back(static_cast<char>(kind));
+    put(buffer_, channel, 2);
+    put(buffer_, timestamp, 8);
+    put(buffer_, length, 4);
+    buffer_.append(static_cast<const char *>(data), length);
+}
+
+void Recorder::message(const std::string& topic, const std::string& payload)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!isRecording_)
+        return ;
+
+    unsigned long long timestamp = now();
+
+    auto id = topics_.find(topic);
+    if (id == topics_.end())
+    {
+        id = topics_.insert({ topic, topics_.size() }).first;
+        append(Kind::TOPIC, id->second, timestamp, topic.data(), topic.size());
+    }
+
+    append(Kind::MESSAGE, id->second, timestamp, payload.data(), payload.size());
+}
+
+void Recorder::output(Kind kind, unsigned channel, const void *data, std::size_t length)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!isRecording_)
+        return ;
+
+    append(kind, channel, now(), data, length);
+}
+
+bool Recorder::isRecording()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return isRecording_;
+}
+
+unsigned long Recorder::dropped()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return dropped_;
+}
+
+Reader::~Reader()
+{
+    if (file_)
+        std::fclose(file_);
+}
+
+bool Reader::open(const std::string& path)
+{
+    if (file_)
+        std::fclose(file_);
+
+    topics_.clear();
+
+    file_ = std::fopen(path.c_str(), "rb");
+    if (!file_)
+        return false;
+
+    unsigned char header[HEADER];
+
+    if (std::fread(header, 1, HEADER, file_) != HEADER || std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0 ||
+        header[sizeof(MAGIC)] != VERSION)
+    {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+
+    return file_ != nullptr;
+}
+
+bool Reader::next(Record& record)
+{
+    if (!file_)
+        return false;
+
+    for (;;)
+    {
+        unsigned char header[RECORD_HEADER];
+
+        if (std::fread(header, 1, RECORD_HEADER, file_) != RECORD_HEADER)
+            return false;
+
+        record.kind         = static_cast<Kind>(header[0]);
+        record.channel      = get(header + 1, 2);
+        record.timestamp    = get(header + 3, 8);
+
+        // A longer record can't have been recorded, the capture is corrupted
+        std::size_t length = get(header + 11, 4);
+        if (length > Recorder::MAX_BUFFER)
+            return false;
+
+        record.data.resize(length);
+        if (!record.data.empty() && std::fread(&record.data[0], 1, record.data.size(), file_) != record.data.size())
+            return false;
+
+        if (record.kind == Kind::TOPIC)
+        {
+            topics_[record.channel] = record.data;
+            continue ;
+        }
+
+        record.topic = record.kind == Kind::MESSAGE ? topics_[record.channel] : std::string();
+        return true;
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Politocean
+{
+    /**
+     * Append-only binary capture of the control traffic of a binary: the MQTT messages
+     * it receives and the frames and pin changes it sends out.
+     * A capture is a header, MAGIC and VERSION padded to HEADER bytes, followed by records of:
+     *  (*) kind, 8 bit
+     *  (*) channel, 16 bit: topic id for MESSAGE and TOPIC, frame class for SPI, pin otherwise
+     *  (*) timestamp, 64 bit, nanoseconds from the start of the capture
+     *  (*) length of the data, 32 bit
+     *  (*) data
+     * All little endian. The first time a topic is used, a TOPIC record with its name as data
+     * assigns it the id of the MESSAGE records.
+     */
+    namespace Capture
+    {
+        const char MAGIC[]                  = { 'P', 'T', 'O', 'C' };
+        const unsigned char VERSION         = 1;
+
+        const std::size_t HEADER            = 8;
+        const std::size_t RECORD_HEADER     = 15;
+
+        /**
+         * @TOPIC   : name of a topic id
+         * @MESSAGE : MQTT payload received
+         * @SPI     : frame sent on the SPI bus
+         * @LEVEL   : pin level written, one byte
+         * @PWM     : soft PWM duty cycle written, 32 bit
+         */
+        enum class Kind : unsigned char { TOPIC, MESSAGE, SPI, LEVEL, PWM };
+
+        struct Record
+        {
+            Kind kind;
+            unsigned channel;
+            unsigned long long timestamp;
+            // Topic of the MESSAGE records
+            std::string topic;
+            std::string data;
+        };
+
+        // @directory/@name-YYYYmmdd-HHMMSS.ptoc, so every run gets a capture of its own
+        std::string path(const std::string& directory, const std::string& name);
+
+        /**
+         * Writes a capture from any thread.
+         * Records are appended to @buffer_ under @mutex_ and written to the file by a thread
+         * of its own every FLUSH_INTERVAL, so recording never waits for the disk. If the disk
+         * can't keep up, records beyond MAX_BUFFER bytes are dropped and counted.
+         */
+        class Recorder
+        {
+            std::FILE *file_;
+
+            std::chrono::steady_clock::time_point start_;
+            double speed_;
+
+            std::map<std::string, unsigned> topics_;
+            std::string buffer_;
+            unsigned long dropped_;
+
+            std::thread *th_;
+            bool isRecording_;
+
+            std::mutex mutex_;
+            std::condition_variable cv_;
+
+            void append(Kind kind, unsigned channel, unsigned long long timestamp, const void *data, std::size_t length);
+            unsigned long long now();
+
+        public:
+            static const std::size_t MAX_BUFFER = 4 << 20;
+            static const int FLUSH_INTERVAL     = 200;
+
+            Recorder() : file_(nullptr), speed_(1), dropped_(0), th_(nullptr), isRecording_(false) {}
+            ~Recorder();
+
+            Recorder(const Recorder &) = delete;
+            Recorder &operator=(const Recorder &) = delete;
+
+            // Creates the capture at @path, returns false if it can't be written
+            bool open(const std::string& path);
+            // Writes the records left and closes the capture
+            void close();
+
+            /**
+             * Scales the timestamps, e.g. to N for a replay at N times the real speed,
+             * so they stay on the time base of the capture replayed.
+             */
+            void setSpeed(double speed);
+
+            void message(const std::string& topic, const std::string& payload);
+            void output(Kind kind, unsigned channel, const void *data, std::size_t length);
+
+            bool isRecording();
+            unsigned long dropped();
+        };
+
+        // Reads a capture back, one record at a time
+        class Reader
+        {
+            std::FILE *file_;
+            std::map<unsigned, std::string> topics_;
+
+        public:
+            Reader() : file_(nullptr) {}
+            ~Reader();
+
+            Reader(const Reader &) = delete;
+            Reader &operator=(const Reader &) = delete;
+
+            // Returns false if @path is not a capture
+            bool open(const std::string& path);
+
+            /**
+             * Reads the next MESSAGE or output record into @record, handling the TOPIC ones.
+             * Returns false at the end of the capture, or at a record cut short by a crash
+             * or longer than Recorder::MAX_BUFFER, which can only come from a corrupted file.
+             */
+            bool next(Record& record);
+        };
+    }
+}
+
+#endif // CAPTURE_H
@@ -1,7 +1,15 @@
 #include "DCMotor.h"
 
+#include <algorithm>
+#include <cstdlib>
+
 using namespace Politocean::RPi;
 
+DCMotor::~DCMotor()
+{
+    stopPwm();
+}
+
 void DCMotor::setup()
 {
     controller_->pinMode(dirPin_, Controller::PinMode::PIN_OUTPUT);
@@ -10,18 +18,69 @@ void DCMotor::setup()
 
 void DCMotor::setDirection(Direction direction)
 {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (direction == direction_)
+        return ;
+
     direction_ = direction;
 
-    if (direction == Direction::CW)
-        controller_->digitalWrite(dirPin_, Controller::PinLevel::PIN_LOW);
-    else if (direction_ == Direction::CCW)
-        controller_->digitalWrite(dirPin_, Controller::PinLevel::PIN_HIGH);
-    else return ;
+    // A stopped motor can be reversed right away
+    if (!isPwming_ && isReversing())
+        writeDirection(direction_);
+
+    cv_.notify_one();
+}
+
+void DCMotor::setLines(GpioLines *lines)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    lines_ = lines;
+}
+
+void DCMotor::writeDirection(Direction direction)
+{
+    pinDirection_ = direction;
+
+    if (direction == Direction::NONE)
+        return ;
+
+    Controller::PinLevel level = direction == Direction::CW ? Controller::PinLevel::PIN_LOW : Controller::PinLevel::PIN_HIGH;
+
+    if (lines_)
+        lines_->write(dirPin_, level);
+    else
+        controller_->digitalWrite(dirPin_, level);
 }
 
 void DCMotor::setVelocity(int velocity)
 {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (velocity == velocity_)
+        return ;
+
     velocity_ = velocity;
+    cv_.notify_one();
+}
+
+void DCMotor::setSlewRate(int up, int down)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    slewUp_     = up;
+    slewDown_   = down;
+}
+
+bool DCMotor::isReversing()
+{
+    return direction_ != Direction::NONE && direction_ != pinDirection_;
+}
+
+int DCMotor::target()
+{
+    return direction_ == Direction::NONE || isReversing() ? 0 : velocity_;
 }
 
 void DCMotor::startPwm()
@@ -29,22 +88,68 @@ void DCMotor::startPwm()
     if (isPwming_)
         return ;
     
-    controller_->softPwmCreate(pwmPin_, minPwm_, maxPwm_);
+    controller_->softPwmCreate(pwmPin_, 0, maxPwm_);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isPwming_ = true;
+    }
+
+    worker_.unpark();
+}
+
+void DCMotor::update()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+    while (isPwming_)
+    {
+        if (pwm_ == 0 && isReversing())
+            writeDirection(direction_);
+
+        int target = this->target();
+
+        if (pwm_ == target)
+        {
+            cv_.wait(lock, [&]() { return !isPwming_ || pwm_ != this->target() || (pwm_ == 0 && isReversing()); });
+            next = std::chrono::steady_clock::now();
+            continue ;
+        }
+
+        int slew = target > pwm_ ? slewUp_ : slewDown_;
+        int step = slew > 0 ? std::max(1, slew * UPDATE_PERIOD / 1000) : std::abs(target - pwm_);
+
+        pwm_ = target > pwm_ ? std::min(target, pwm_ + step) : std::max(target, pwm_ - step);
+        controller_->softPwmWrite(pwmPin_, pwm_);
 
-    isPwming_ = true;
-    th_ = new std::thread([&]() {
-        while (isPwming_)
-            controller_->softPwmWrite(pwmPin_, velocity_);
-    });
+        // Reached the target, unless it is the zero before reversing, which is held for a period
+        if (pwm_ == this->target() && !isReversing())
+            continue ;
+
+        next += std::chrono::milliseconds(UPDATE_PERIOD);
+        cv_.wait_until(lock, next, [&]() { return !isPwming_; });
+    }
 }
 
 void DCMotor::stopPwm()
 {
-    isPwming_ = false;
+    if (!isPwming_)
+        return ;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isPwming_ = false;
+        cv_.notify_one();
+    }
+
+    worker_.park();
+
     controller_->softPwmStop(pwmPin_);
+    pwm_ = 0;
 }
 
 bool DCMotor::isPwming()
 {
     return isPwming_;
-}
\ No newline at end of file
+}
@@ -1,10 +1,14 @@
 #ifndef DC_MOTOR_H
 #define DC_MOTOR_H
 
-#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 #include "Direction.h"
 #include "Controller.h"
+#include "GpioLines.h"
+#include "Worker.h"
 
 namespace Politocean
 {
@@ -13,27 +17,64 @@ namespace Politocean
         class DCMotor
         {
             Controller *controller_;
+            // Lines driving @dirPin_ instead of @controller_, if not nullptr
+            GpioLines *lines_;
 
             int dirPin_, pwmPin_, minPwm_, maxPwm_;
             
-            Direction direction_;
+            /**
+             * @direction_ and @velocity_ are the requested ones,
+             * @pinDirection_ is the one last written to @dirPin_.
+             */
+            Direction direction_, pinDirection_;
             int velocity_;
 
-            std::thread *th_;
-            bool isPwming_;
+            // Written under @mutex_, but also read by startPwm(), stopPwm() and isPwming()
+            std::atomic<bool> isPwming_;
+
+            /**
+             * The PWM thread moves @pwm_, the duty cycle last written, toward the target
+             * every UPDATE_PERIOD ms, by at most @slewUp_ or @slewDown_ per second when it
+             * is rising or falling, and sleeps on @cv_ once it gets there.
+             * Before reversing the target is zero: the new direction is only written
+             * once the motor is no longer driven.
+             */
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            int pwm_;
+            int slewUp_, slewDown_;
+
+            // Runs update() from startPwm() to stopPwm(), parked in between
+            Worker worker_;
+
+            void writeDirection(Direction direction);
+            void update();
+
+            bool isReversing();
+            int target();
         
         public:
             static const int PWM_MIN = 20;
             static const int PWM_MAX = 200;
 
+            static const int UPDATE_PERIOD = 10;
+
             DCMotor(Controller *controller, int dirPin, int pwmPin, int minPwm, int maxPwm) :
-                controller_(controller), dirPin_(dirPin), pwmPin_(pwmPin), minPwm_(minPwm), maxPwm_(maxPwm), isPwming_(false) {}
+                controller_(controller), lines_(nullptr), dirPin_(dirPin), pwmPin_(pwmPin), minPwm_(minPwm), maxPwm_(maxPwm),
+                direction_(Direction::NONE), pinDirection_(Direction::NONE), velocity_(0), isPwming_(false),
+                pwm_(0), slewUp_(0), slewDown_(0), worker_(Realtime::PWM, [this]() { update(); }) {}
+            ~DCMotor();
             
             void setup();
+            // Drives the direction pin through @lines from now on, the PWM stays on the Controller
+            void setLines(GpioLines *lines);
             
             void setDirection(Direction direction);
             void setVelocity(int velocity);
 
+            // Duty cycle change limits in PWM units per second, 0 for none
+            void setSlewRate(int up, int down);
+
             void startPwm();
             void stopPwm();
 
@@ -42,4 +83,4 @@ namespace Politocean
     }
 }
 
-#endif // DC_MOTOR_H
\ No newline at end of file
+#endif // DC_MOTOR_H
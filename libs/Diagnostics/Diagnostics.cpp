@@ -0,0 +1,90 @@
+#include "Diagnostics.h"
+
+#include "json.hpp"
+
+using namespace Politocean;
+
+Diagnostics::~Diagnostics()
+{
+    stopPublishing();
+}
+
+void Diagnostics::add(const std::string& name, Histogram& histogram)
+{
+    histograms_.push_back({ name, &histogram, histogram.snapshot() });
+}
+
+void Diagnostics::add(const std::string& name, std::function<unsigned long()> counter)
+{
+    counters_.push_back({ name, counter });
+}
+
+std::string Diagnostics::summary()
+{
+    nlohmann::json message;
+
+    message["interval_ms"] = static_cast<long long>(interval_.count());
+
+    for (Entry& entry : histograms_)
+    {
+        Histogram::Snapshot current = entry.histogram->take();
+        Histogram::Snapshot window  = current - entry.last;
+        entry.last = current;
+
+        nlohmann::json& histogram = message["histograms"][entry.name];
+        histogram["count"]      = window.count;
+        histogram["mean_us"]    = window.mean();
+        histogram["p50_us"]     = window.count ? window.percentile(0.5) : 0;
+        histogram["p99_us"]     = window.count ? window.percentile(0.99) : 0;
+        histogram["max_us"]     = window.max / 1000;
+    }
+
+    for (auto& counter : counters_)
+        message["counters"][counter.first] = counter.second();
+
+    return message.dump();
+}
+
+void Diagnostics::startPublishing(MqttClient& publisher, const std::string& topic, std::chrono::milliseconds interval)
+{
+    if (isPublishing_)
+        return ;
+
+    interval_       = interval;
+    isPublishing_   = true;
+
+    th_ = new std::thread([this, &publisher, topic]() {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        while (isPublishing_)
+        {
+            if (cv_.wait_for(lock, interval_, [this]() { return !isPublishing_; }))
+                break ;
+
+            // While disconnected the samples pile up into the first summary after the reconnection
+            if (publisher.is_connected())
+                publisher.publish(topic, summary());
+        }
+    });
+}
+
+void Diagnostics::stopPublishing()
+{
+    if (!isPublishing_)
+        return ;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isPublishing_ = false;
+        cv_.notify_one();
+    }
+
+    th_->join();
+    delete th_;
+    th_ = nullptr;
+}
+
+bool Diagnostics::isPublishing()
+{
+    return isPublishing_;
+}
@@ -0,0 +1,65 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Histogram.h"
+#include "MqttClient.h"
+#include "RovTopics.h"
+
+namespace Politocean
+{
+    /**
+     * Publishes a summary of the timing of a binary every @interval_, as a JSON object with:
+     *  (*) "histograms" : count, mean, p50, p99 and max in us of each histogram,
+     *                     over the samples recorded since the previous summary
+     *  (*) "counters"   : current value of each counter
+     * Percentiles are the upper bounds of their Histogram buckets.
+     */
+    class Diagnostics
+    {
+        struct Entry
+        {
+            std::string name;
+            Histogram *histogram;
+            Histogram::Snapshot last;
+        };
+
+        std::vector<Entry> histograms_;
+        std::vector<std::pair<std::string, std::function<unsigned long()>>> counters_;
+
+        std::thread *th_;
+        bool isPublishing_;
+
+        std::chrono::milliseconds interval_;
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+
+    public:
+        Diagnostics() : th_(nullptr), isPublishing_(false), interval_(0) {}
+        ~Diagnostics();
+
+        // Histograms and counters must all be added before startPublishing()
+        void add(const std::string& name, Histogram& histogram);
+        void add(const std::string& name, std::function<unsigned long()> counter);
+
+        // Summary of the samples recorded since the previous one
+        std::string summary();
+
+        // Publishes a summary every @interval until stopPublishing(), skipping it while @publisher is disconnected
+        void startPublishing(MqttClient& publisher, const std::string& topic, std::chrono::milliseconds interval);
+        void stopPublishing();
+
+        bool isPublishing();
+    };
+}
+
+#endif // DIAGNOSTICS_H
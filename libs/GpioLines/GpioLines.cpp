@@ -0,0 +1,166 @@
+#include "GpioLines.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+using namespace Politocean::RPi;
+
+bool GpioLines::Batch::add(int pin, Controller::PinLevel level)
+{
+    if (size_ == MAX_LINES)
+        return false;
+
+    levels_[size_++] = { pin, level };
+    return true;
+}
+
+void GpioLines::Batch::clear()
+{
+    size_ = 0;
+}
+
+bool GpioLines::Batch::empty() const
+{
+    return size_ == 0;
+}
+
+GpioLines::~GpioLines()
+{
+    if (fd_ >= 0)
+        close(fd_);
+}
+
+bool GpioLines::setup(const std::string &chip, const std::vector<int> &pins, const std::string &consumer)
+{
+    if (pins.empty() || pins.size() > MAX_LINES)
+        return false;
+
+    gpio_v2_line_request request;
+    std::memset(&request, 0, sizeof(request));
+
+    std::strncpy(request.consumer, consumer.c_str(), GPIO_MAX_NAME_SIZE - 1);
+    request.num_lines               = pins.size();
+    request.config.flags            = GPIO_V2_LINE_FLAG_OUTPUT;
+    request.config.num_attrs        = 1;
+    request.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+
+    for (std::size_t i = 0; i < pins.size(); i++)
+    {
+        if (pins[i] < 0)
+            return false;
+
+        request.offsets[i] = pins[i];
+
+        // Requesting the lines must not glitch them, e.g. enable a stepper driver
+        if (controller_.digitalRead(pins[i]) == Controller::PinLevel::PIN_HIGH)
+            request.config.attrs[0].attr.values |= 1ULL << i;
+    }
+    request.config.attrs[0].mask = pins.size() == MAX_LINES ? ~0ULL : (1ULL << pins.size()) - 1;
+
+    int fd = open(chip.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    int result = ioctl(fd, GPIO_V2_GET_LINE_IOCTL, &request);
+    close(fd);
+
+    if (result < 0 || request.fd < 0)
+        return false;
+
+    if (fd_ >= 0)
+        close(fd_);
+    fd_ = request.fd;
+    isFailed_ = false;
+
+    indexes_.assign(*std::max_element(pins.begin(), pins.end()) + 1, -1);
+    for (std::size_t i = 0; i < pins.size(); i++)
+        indexes_[pins[i]] = i;
+
+    return true;
+}
+
+int GpioLines::index(int pin) const
+{
+    if (fd_ < 0 || isFailed_ || pin < 0 || pin >= static_cast<int>(indexes_.size()))
+        return -1;
+
+    return indexes_[pin];
+}
+
+void GpioLines::fallBack()
+{
+    isFailed_ = true;
+}
+
+void GpioLines::write(int pin, Controller::PinLevel level)
+{
+    Batch batch;
+    batch.add(pin, level);
+
+    write(batch);
+}
+
+void GpioLines::write(const Batch &batch)
+{
+    gpio_v2_line_values values;
+    values.bits = values.mask = 0;
+
+    for (std::size_t i = 0; i < batch.size_; i++)
+    {
+        const Batch::Level &level = batch.levels_[i];
+        int index = this->index(level.pin);
+
+        if (index < 0)
+        {
+            controller_.digitalWrite(level.pin, level.level);
+            continue ;
+        }
+
+        std::uint64_t bit = 1ULL << index;
+
+        values.mask |= bit;
+        if (level.level == Controller::PinLevel::PIN_HIGH)
+            values.bits |= bit;
+        else
+            values.bits &= ~bit;
+    }
+
+    if (!values.mask || ioctl(fd_, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) >= 0)
+        return ;
+
+    // The line request is no longer usable: go through the Controller from now on
+    fallBack();
+
+    for (std::size_t i = 0; i < batch.size_; i++)
+        controller_.digitalWrite(batch.levels_[i].pin, batch.levels_[i].level);
+}
+
+Controller::PinLevel GpioLines::read(int pin)
+{
+    int index = this->index(pin);
+    if (index < 0)
+        return controller_.digitalRead(pin);
+
+    gpio_v2_line_values values;
+    values.bits = 0;
+    values.mask = 1ULL << index;
+
+    if (ioctl(fd_, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0)
+    {
+        fallBack();
+        return controller_.digitalRead(pin);
+    }
+
+    return values.bits & (1ULL << index) ? Controller::PinLevel::PIN_HIGH : Controller::PinLevel::PIN_LOW;
+}
+
+bool GpioLines::isRequested()
+{
+    return fd_ >= 0 && !isFailed_;
+}
@@ -0,0 +1,95 @@
+#ifndef GPIO_LINES_H
+#define GPIO_LINES_H
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Controller.h"
+
+namespace Politocean
+{
+    namespace RPi
+    {
+        /**
+         * Output pins driven through the kernel gpio character device, with v2 line requests.
+         *
+         * The pins are requested from a gpio chip as a single set of lines, with the pin numbers
+         * as line offsets, so any number of them can be set with one ioctl through a Batch.
+         * Pins outside the request, or all of them if the chip can't be used, fall back to
+         * Controller::digitalWrite(), one call per pin.
+         */
+        class GpioLines
+        {
+        public:
+            static const std::size_t MAX_LINES = 64;
+
+            // Pin levels to be written together by write(const Batch&)
+            class Batch
+            {
+                friend class GpioLines;
+
+                struct Level
+                {
+                    int pin;
+                    Controller::PinLevel level;
+                };
+
+                Level levels_[MAX_LINES];
+                std::size_t size_;
+
+            public:
+                Batch() : size_(0) {}
+
+                // Returns false, leaving the batch as it is, if it is full
+                bool add(int pin, Controller::PinLevel level);
+                void clear();
+
+                bool empty() const;
+            };
+
+        private:
+            Controller &controller_;
+
+            /**
+             * @fd_         : line request, -1 if every pin falls back to the Controller
+             * @isFailed_   : the line request is no longer usable and every pin falls back to the Controller.
+             *                @fd_ stays open until the destructor, since other threads may still be using it
+             * @indexes_    : index in the line request of each pin, -1 if it is not in it
+             */
+            int fd_;
+            std::atomic<bool> isFailed_;
+            std::vector<int> indexes_;
+
+            int index(int pin) const;
+            void fallBack();
+
+        public:
+            GpioLines(Controller &controller) : controller_(controller), fd_(-1), isFailed_(false) {}
+            ~GpioLines();
+
+            GpioLines(const GpioLines &) = delete;
+            GpioLines &operator=(const GpioLines &) = delete;
+
+            /**
+             * Requests @pins from @chip, e.g. /dev/gpiochip0, as outputs for @consumer.
+             * They keep the level they have been given with the Controller, so the pins must be
+             * set up before. Returns false if all the pins will fall back to the Controller.
+             * To be called before the lines are shared with other threads, which can then
+             * write and read them concurrently.
+             */
+            bool setup(const std::string &chip, const std::vector<int> &pins, const std::string &consumer);
+
+            void write(int pin, Controller::PinLevel level);
+            // Sets all the pins of @batch in the line request with a single ioctl
+            void write(const Batch &batch);
+
+            Controller::PinLevel read(int pin);
+
+            bool isRequested();
+        };
+    }
+}
+
+#endif // GPIO_LINES_H
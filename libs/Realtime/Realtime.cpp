@@ -0,0 +1,166 @@
+#include "Realtime.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace Politocean::RPi;
+
+namespace
+{
+    const int DEFAULT_PRIORITY              = 80;
+    const std::size_t DEFAULT_PREFAULT      = 8 * 1024 * 1024;
+    const std::size_t STACK_PREFAULT        = 256 * 1024;
+
+    Realtime::Profile profile_ = {};
+
+    // Touches every page of the first STACK_PREFAULT bytes of the stack
+    void prefaultStack()
+    {
+        volatile unsigned char stack[STACK_PREFAULT];
+        long page = sysconf(_SC_PAGESIZE);
+
+        for (std::size_t i = 0; i < STACK_PREFAULT; i += page)
+            stack[i] = 0;
+
+        (void) stack[0];
+    }
+
+    void prefaultHeap(std::size_t size)
+    {
+        // Keep the pages in the heap once freed, and never get them from mmap()
+        mallopt(M_TRIM_THRESHOLD, -1);
+        mallopt(M_MMAP_MAX, 0);
+
+        unsigned char *heap = static_cast<unsigned char *>(std::malloc(size));
+        if (heap == nullptr)
+            return ;
+
+        long page = sysconf(_SC_PAGESIZE);
+        for (std::size_t i = 0; i < size; i += page)
+            heap[i] = 0;
+
+        std::free(heap);
+    }
+}
+
+Realtime::Profile Realtime::fromEnvironment()
+{
+    Profile profile = {};
+
+    const char *enabled = std::getenv("POLITOCEAN_RT");
+    profile.enabled = enabled != nullptr && std::strcmp(enabled, "1") == 0;
+
+    const char *priority = std::getenv("POLITOCEAN_RT_PRIORITY");
+    int top = priority != nullptr ? std::atoi(priority) : DEFAULT_PRIORITY;
+    if (top < 31 || top > sched_get_priority_max(SCHED_FIFO))
+        top = DEFAULT_PRIORITY;
+
+    profile.priorities[MOTION]  = top;
+    profile.priorities[BUS]     = top;
+    profile.priorities[PWM]     = top - 10;
+    profile.priorities[TALKER]  = top - 30;
+
+    profile.pinned[MOTION]  = true;
+    profile.pinned[BUS]     = true;
+
+    const char *cpus = std::getenv("POLITOCEAN_RT_CPUS");
+    if (cpus != nullptr)
+    {
+        std::istringstream list(cpus);
+        std::string cpu;
+
+        while (std::getline(list, cpu, ','))
+            if (!cpu.empty())
+                profile.cpus.push_back(std::atoi(cpu.c_str()));
+    }
+
+    const char *mlock = std::getenv("POLITOCEAN_RT_MLOCK");
+    profile.lockMemory  = mlock == nullptr || std::strcmp(mlock, "0") != 0;
+    profile.prefault    = DEFAULT_PREFAULT;
+
+    return profile;
+}
+
+bool Realtime::configure(const Profile& profile, std::string& error)
+{
+    profile_.enabled = false;
+
+    if (!profile.enabled)
+        return true;
+
+    // Try SCHED_FIFO on this thread, then restore its policy
+    int policy;
+    sched_param previous, probe;
+    pthread_getschedparam(pthread_self(), &policy, &previous);
+
+    probe.sched_priority = sched_get_priority_min(SCHED_FIFO);
+
+    int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &probe);
+    if (result != 0)
+    {
+        error = std::string("SCHED_FIFO not permitted: ") + std::strerror(result);
+        return false;
+    }
+
+    pthread_setschedparam(pthread_self(), policy, &previous);
+
+    long cores = sysconf(_SC_NPROCESSORS_CONF);
+    for (int cpu : profile.cpus)
+        if (cpu < 0 || cpu >= cores || cpu >= CPU_SETSIZE)
+        {
+            error = "No CPU " + std::to_string(cpu) + " to pin the control threads to";
+            return false;
+        }
+
+    if (profile.lockMemory)
+    {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+        {
+            error = std::string("Can't lock the memory: ") + std::strerror(errno);
+            return false;
+        }
+
+        prefaultHeap(profile.prefault);
+        prefaultStack();
+    }
+
+    profile_ = profile;
+    return true;
+}
+
+bool Realtime::apply(Role role)
+{
+    if (!profile_.enabled)
+        return true;
+
+    bool applied = true;
+
+    if (profile_.priorities[role] > 0)
+    {
+        sched_param param;
+        param.sched_priority = profile_.priorities[role];
+
+        applied = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+    }
+
+    if (profile_.pinned[role] && !profile_.cpus.empty())
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+
+        for (int cpu : profile_.cpus)
+            CPU_SET(cpu, &cpus);
+
+        applied = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0 && applied;
+    }
+
+    return applied;
+}
@@ -0,0 +1,71 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Politocean
+{
+    namespace RPi
+    {
+        /**
+         * Real-time profile of the control threads.
+         *
+         * Every thread owned by the motor and bus classes calls apply() with its role when it
+         * starts. Until configure() is called with an enabled profile, apply() does nothing,
+         * so the threads run at the default priority as before.
+         */
+        class Realtime
+        {
+        public:
+            /**
+             * @MOTION  : stepper edges, MotionScheduler or Stepper loops
+             * @BUS     : the ATMega SPI bus
+             * @PWM     : DC motor duty cycle updates
+             * @TALKER  : sensors publishing
+             */
+            enum Role { MOTION, BUS, PWM, TALKER, ROLES };
+
+            /**
+             * @enabled     : SCHED_FIFO for the roles with a non zero priority
+             * @priorities  : SCHED_FIFO priority of each role, 0 to leave it at the default
+             * @pinned      : whether the threads of each role are pinned to @cpus
+             * @cpus        : cores reserved to the pinned threads, e.g. isolated with isolcpus
+             * @lockMemory  : mlockall() the process, then pre-fault @prefault bytes of heap
+             *                and the stack of the thread calling configure()
+             */
+            struct Profile
+            {
+                bool enabled;
+                int priorities[ROLES];
+                bool pinned[ROLES];
+                std::vector<int> cpus;
+                bool lockMemory;
+                std::size_t prefault;
+            };
+
+            /**
+             * Profile from the environment, disabled unless POLITOCEAN_RT is set to 1:
+             *  POLITOCEAN_RT_PRIORITY  : priority of the MOTION and BUS threads, 80 by default;
+             *                            PWM and TALKER run 10 and 30 below it
+             *  POLITOCEAN_RT_CPUS      : comma separated cores for the MOTION and BUS threads
+             *  POLITOCEAN_RT_MLOCK     : 0 to skip memory locking
+             */
+            static Profile fromEnvironment();
+
+            /**
+             * Enables @profile for the threads started from now on, and locks the memory.
+             * It must be called before any of the control threads is started.
+             * Returns false and leaves the profile disabled if any part of it can't be applied,
+             * e.g. SCHED_FIFO is not permitted, with the reason in @error.
+             */
+            static bool configure(const Profile& profile, std::string& error);
+
+            // Applies the profile of @role to the calling thread, returns false if it fails
+            static bool apply(Role role);
+        };
+    }
+}
+
+#endif // REALTIME_H
@@ -0,0 +1,80 @@
+#include "Worker.h"
+
+using namespace Politocean::RPi;
+
+Worker::~Worker()
+{
+    stop();
+}
+
+void Worker::loop()
+{
+    Realtime::apply(role_);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true)
+    {
+        cv_.wait(lock, [this]() { return isPending_ || isQuitting_; });
+
+        if (isQuitting_)
+            break ;
+
+        isPending_ = false;
+        isRunning_ = true;
+
+        lock.unlock();
+        task_();
+        lock.lock();
+
+        isRunning_ = false;
+        cv_.notify_all();
+    }
+}
+
+void Worker::unpark()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!th_)
+        th_ = new std::thread([this]() { loop(); });
+
+    isPending_ = true;
+    cv_.notify_all();
+}
+
+void Worker::park()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    cv_.wait(lock, [this]() { return !th_ || (!isPending_ && !isRunning_); });
+}
+
+void Worker::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (!th_)
+            return ;
+
+        isQuitting_ = true;
+        cv_.notify_all();
+    }
+
+    th_->join();
+    delete th_;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    th_         = nullptr;
+    isPending_  = false;
+    isQuitting_ = false;
+}
+
+bool Worker::isParked()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return !isPending_ && !isRunning_;
+}
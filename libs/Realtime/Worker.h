@@ -0,0 +1,64 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "Realtime.h"
+
+namespace Politocean
+{
+    namespace RPi
+    {
+        /**
+         * Long-lived thread running a task on demand, for the motors started and stopped
+         * over and over during a dive.
+         *
+         * The thread is created by the first unpark(), so it gets the real-time profile of
+         * @role_ configured by then, and it is parked on @cv_ between runs of @task_.
+         * The owner makes @task_ return, e.g. by clearing its own running flag, and then
+         * park() waits for it. The thread is joined by stop() or by the destructor.
+         */
+        class Worker
+        {
+            Realtime::Role role_;
+            std::function<void()> task_;
+
+            std::thread *th_;
+
+            /**
+             * @isPending_  : unpark() was called since @task_ last started
+             * @isRunning_  : @task_ is running
+             * @isQuitting_ : stop() was called, the thread exits instead of running @task_
+             */
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            bool isPending_, isRunning_, isQuitting_;
+
+            void loop();
+
+        public:
+            Worker(Realtime::Role role, std::function<void()> task) :
+                role_(role), task_(task), th_(nullptr), isPending_(false), isRunning_(false), isQuitting_(false) {}
+            ~Worker();
+
+            Worker(const Worker &) = delete;
+            Worker &operator=(const Worker &) = delete;
+
+            // Runs the task, or runs it once more as soon as it returns if it is running
+            void unpark();
+
+            // Waits until the task has returned and no run of it is pending
+            void park();
+
+            // Waits for the task to return and joins the thread
+            void stop();
+
+            bool isParked();
+        };
+    }
+}
+
+#endif // WORKER_H
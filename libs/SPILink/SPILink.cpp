@@ -0,0 +1,91 @@
+#include "SPILink.h"
+
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <linux/spi/spidev.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+using namespace Politocean::RPi;
+
+SPILink::~SPILink()
+{
+    if (fd_ >= 0)
+        close(fd_);
+}
+
+bool SPILink::setup(int channel, int speed, unsigned short delay)
+{
+    speed_ = speed;
+    delay_ = delay;
+
+    std::string device = "/dev/spidev0." + std::to_string(channel);
+
+    fd_ = open(device.c_str(), O_RDWR);
+    if (fd_ < 0)
+        return false;
+
+    unsigned char mode  = SPI_MODE_0;
+    unsigned char bits  = 8;
+    unsigned int hz     = speed;
+
+    if (ioctl(fd_, SPI_IOC_WR_MODE, &mode) < 0 ||
+        ioctl(fd_, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||
+        ioctl(fd_, SPI_IOC_WR_MAX_SPEED_HZ, &hz) < 0)
+    {
+        close(fd_);
+        fd_ = -1;
+    }
+
+    return fd_ >= 0;
+}
+
+void SPILink::transferBytes(unsigned char *data, std::size_t length)
+{
+    for (std::size_t i = 0; i < length; i++)
+        data[i] = controller_.SPIDataRW(data[i]);
+}
+
+void SPILink::transfer(unsigned char *data, std::size_t length)
+{
+    if (fd_ < 0 || length > MAX_FRAME)
+    {
+        transferBytes(data, length);
+        return ;
+    }
+
+    unsigned char received[MAX_FRAME];
+
+    spi_ioc_transfer segments[MAX_FRAME];
+    std::memset(segments, 0, sizeof(segments));
+
+    for (std::size_t i = 0; i < length; i++)
+    {
+        segments[i].tx_buf          = reinterpret_cast<unsigned long>(data + i);
+        segments[i].rx_buf          = reinterpret_cast<unsigned long>(received + i);
+        segments[i].len             = 1;
+        segments[i].speed_hz        = speed_;
+        segments[i].delay_usecs     = delay_;
+        segments[i].bits_per_word   = 8;
+        segments[i].cs_change       = i + 1 < length;
+    }
+
+    if (ioctl(fd_, SPI_IOC_MESSAGE(length), segments) >= 0)
+    {
+        std::memcpy(data, received, length);
+        return ;
+    }
+
+    // The driver refused the message: stop using it and go byte by byte
+    close(fd_);
+    fd_ = -1;
+
+    transferBytes(data, length);
+}
+
+bool SPILink::isFramed()
+{
+    return fd_ >= 0;
+}
@@ -0,0 +1,52 @@
+#ifndef SPI_LINK_H
+#define SPI_LINK_H
+
+#include <cstddef>
+
+#include "Controller.h"
+
+namespace Politocean
+{
+    namespace RPi
+    {
+        /**
+         * Full-duplex SPI link transferring whole frames in a single transaction.
+         *
+         * Each byte of a frame is still sent as its own chip-select cycle, like
+         * Controller::SPIDataRW() does, but all of them are queued to the spidev
+         * driver with one ioctl. If the spidev device can't be used the link falls
+         * back to one Controller::SPIDataRW() call per byte.
+         */
+        class SPILink
+        {
+            Controller &controller_;
+
+            int fd_, speed_;
+            unsigned short delay_;
+
+            void transferBytes(unsigned char *data, std::size_t length);
+
+        public:
+            static const std::size_t MAX_FRAME = 16;
+
+            SPILink(Controller &controller) : controller_(controller), fd_(-1), speed_(0), delay_(0) {}
+            ~SPILink();
+
+            SPILink(const SPILink &) = delete;
+            SPILink &operator=(const SPILink &) = delete;
+
+            /**
+             * Opens the spidev device of @channel at @speed Hz, with @delay microseconds
+             * between bytes. Returns false if the link will fall back to the Controller.
+             */
+            bool setup(int channel, int speed, unsigned short delay = 0);
+
+            // Sends @length bytes of @data and overwrites them with the bytes received
+            void transfer(unsigned char *data, std::size_t length);
+
+            bool isFramed();
+        };
+    }
+}
+
+#endif // SPI_LINK_H
@@ -0,0 +1,254 @@
+#include "Controller.h"
+
+#include <algorithm>
+#include <string>
+#include <time.h>
+
+#include "Commands.h"
+#include "Sensor.h"
+
+using namespace Politocean;
+using namespace Politocean::RPi;
+using namespace Politocean::Constants;
+
+namespace
+{
+    long long timestamp()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return static_cast<long long>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+}
+
+Controller::Controller() :
+    channel_(DEFAULT_SPI_CHANNEL), motors_(false), frameState_(FrameState::DELIMITER), frameReceived_(0), axes_(),
+    sensors_(static_cast<std::size_t>(sensor_t::Last) + 1, 0), replySent_(0)
+{}
+
+void Controller::setup() {}
+
+Controller::PinLevel Controller::setupMotors()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return motors_ ? PinLevel::PIN_HIGH : PinLevel::PIN_LOW;
+}
+
+void Controller::startMotors()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    motors_ = true;
+}
+
+void Controller::stopMotors()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    motors_ = false;
+}
+
+void Controller::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    motors_ = false;
+
+    for (auto &level : levels_)
+    {
+        if (level.second == PinLevel::PIN_LOW)
+            continue;
+
+        level.second = PinLevel::PIN_LOW;
+        record(Event::Type::LEVEL, level.first, static_cast<int>(PinLevel::PIN_LOW));
+    }
+}
+
+void Controller::record(Event::Type type, int pin, int value)
+{
+    if (events_.size() == MAX_EVENTS)
+        events_.pop_front();
+
+    events_.push_back({ type, pin, value, timestamp() });
+
+    if (observer_)
+        observer_(events_.back());
+}
+
+void Controller::pinMode(int pin, PinMode mode)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    record(Event::Type::MODE, pin, static_cast<int>(mode));
+}
+
+void Controller::digitalWrite(int pin, PinLevel level)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    levels_[pin] = level;
+    record(Event::Type::LEVEL, pin, static_cast<int>(level));
+}
+
+Controller::PinLevel Controller::digitalRead(int pin)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto level = levels_.find(pin);
+    return level == levels_.end() ? PinLevel::PIN_LOW : level->second;
+}
+
+void Controller::softPwmCreate(int pin, int value, int range)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    ranges_[pin]    = range;
+    pwms_[pin]      = std::max(0, std::min(value, range));
+
+    record(Event::Type::PWM, pin, pwms_[pin]);
+}
+
+void Controller::softPwmWrite(int pin, int value)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto range = ranges_.find(pin);
+    if (range == ranges_.end())
+        return;
+
+    pwms_[pin] = std::max(0, std::min(value, range->second));
+    record(Event::Type::PWM, pin, pwms_[pin]);
+}
+
+void Controller::softPwmStop(int pin)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (ranges_.erase(pin) == 0)
+        return;
+
+    pwms_[pin] = 0;
+    record(Event::Type::PWM, pin, 0);
+}
+
+int Controller::pwm(int pin)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto value = pwms_.find(pin);
+    return value == pwms_.end() ? 0 : value->second;
+}
+
+std::vector<Controller::Event> Controller::events()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return std::vector<Event>(events_.begin(), events_.end());
+}
+
+void Controller::clearEvents()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    events_.clear();
+}
+
+void Controller::setObserver(std::function<void(const Event&)> observer)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    observer_ = observer;
+}
+
+void Controller::setupSPI(int channel, int speed)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    channel_ = channel;
+}
+
+unsigned char Controller::SPIDataRW(unsigned char data)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    record(Event::Type::SPI, channel_, data);
+
+    receive(data);
+    return reply();
+}
+
+void Controller::receive(unsigned char data)
+{
+    // Axes are mapped to [1, UCHAR_MAX - 1], so delimiters can only be found at the start of a frame
+    switch (frameState_)
+    {
+    case FrameState::DELIMITER:
+        frameReceived_ = 0;
+
+        if (data == Commands::ATMega::SPI::Delims::AXES)
+            frameState_ = FrameState::AXES;
+        else if (data == Commands::ATMega::SPI::Delims::COMMAND)
+            frameState_ = FrameState::COMMAND;
+        break;
+
+    case FrameState::AXES:
+        axes_[frameReceived_++] = data;
+
+        if (frameReceived_ == AXES_COUNT)
+            frameState_ = FrameState::DELIMITER;
+        break;
+
+    case FrameState::COMMAND:
+        commands_.push_back(data);
+        frameState_ = FrameState::DELIMITER;
+        break;
+    }
+}
+
+unsigned char Controller::reply()
+{
+    if (replySent_ == reply_.size())
+    {
+        // Frame: delimiter, length, values, 8-bit sum of length and values
+        unsigned char checksum = static_cast<unsigned char>(sensors_.size());
+
+        reply_.clear();
+        reply_.push_back(Commands::ATMega::SPI::Delims::SENSORS);
+        reply_.push_back(checksum);
+
+        for (unsigned char value : sensors_)
+        {
+            reply_.push_back(value);
+            checksum += value;
+        }
+
+        reply_.push_back(checksum);
+        replySent_ = 0;
+    }
+
+    return reply_[replySent_++];
+}
+
+void Controller::setSensor(std::size_t index, unsigned char value)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (index < sensors_.size())
+        sensors_[index] = value;
+}
+
+std::vector<unsigned char> Controller::axes()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return std::vector<unsigned char>(axes_, axes_ + AXES_COUNT);
+}
+
+std::vector<unsigned char> Controller::commands()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return commands_;
+}
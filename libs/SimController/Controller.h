@@ -0,0 +1,136 @@
+#ifndef SIM_CONTROLLER_H
+#define SIM_CONTROLLER_H
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace Politocean
+{
+    namespace RPi
+    {
+        /**
+         * Simulated Controller, built instead of the rov_common one with POLITOCEAN_SIMULATOR.
+         *
+         * It has the same interface, without touching any hardware:
+         *  - every pin write is recorded as an Event with a CLOCK_MONOTONIC timestamp in nanoseconds
+         *  - soft PWM channels keep their value and record each write
+         *  - every SPI byte sent is recorded too, and goes to a virtual ATMega which parses
+         *    axes and command frames and sends back the sensors as framed, checksummed values
+         */
+        class Controller
+        {
+        public:
+            static const int DEFAULT_SPI_CHANNEL    = 0;
+            static const int DEFAULT_SPI_SPEED      = 1000000;
+
+            static const std::size_t MAX_EVENTS     = 1 << 20;
+            static const std::size_t AXES_COUNT     = 4;
+
+            enum class PinMode { PIN_INPUT, PIN_OUTPUT };
+            enum class PinLevel { PIN_LOW, PIN_HIGH };
+
+            /**
+             * A recorded pin change.
+             * @value is the PinLevel for LEVEL events, the duty cycle for PWM events
+             * and the byte sent for SPI events, whose @pin is the SPI channel.
+             */
+            struct Event
+            {
+                enum class Type { MODE, LEVEL, PWM, SPI };
+
+                Type type;
+                int pin, value;
+                long long timestamp;
+            };
+
+        private:
+            enum class FrameState { DELIMITER, AXES, COMMAND };
+
+            /**
+             * @levels_     : last level written to each pin
+             * @ranges_     : range of each soft PWM channel
+             * @pwms_       : last value written to each soft PWM channel
+             * @events_     : recorded pin changes, the oldest are dropped after MAX_EVENTS
+             * @observer_   : called with each event as it is recorded
+             */
+            std::mutex mutex_;
+
+            std::map<int, PinLevel> levels_;
+            std::map<int, int> ranges_, pwms_;
+            std::deque<Event> events_;
+            std::function<void(const Event&)> observer_;
+
+            int channel_;
+            bool motors_;
+
+            /**
+             * Virtual ATMega.
+             * @axes_       : last axes frame received
+             * @commands_   : command codes received, in order
+             * @sensors_    : raw sensor values sent back, indexed by sensor_t
+             * @reply_      : sensors frame being sent, one byte per SPIDataRW()
+             */
+            FrameState frameState_;
+            std::size_t frameReceived_;
+
+            unsigned char axes_[AXES_COUNT];
+            std::vector<unsigned char> commands_;
+
+            std::vector<unsigned char> sensors_, reply_;
+            std::size_t replySent_;
+
+            void record(Event::Type type, int pin, int value);
+
+            void receive(unsigned char data);
+            unsigned char reply();
+
+        public:
+            Controller();
+
+            void setup();
+            // Returns the motors power level
+            PinLevel setupMotors();
+
+            void startMotors();
+            void stopMotors();
+            void reset();
+
+            void pinMode(int pin, PinMode mode);
+            void digitalWrite(int pin, PinLevel level);
+            PinLevel digitalRead(int pin);
+
+            void softPwmCreate(int pin, int value, int range);
+            void softPwmWrite(int pin, int value);
+            void softPwmStop(int pin);
+
+            void setupSPI(int channel, int speed);
+            unsigned char SPIDataRW(unsigned char data);
+
+            // Recorded events, oldest first
+            std::vector<Event> events();
+            void clearEvents();
+
+            /**
+             * Calls @observer with each event from now on, from the thread that caused it.
+             * It is called with the Controller locked, so it must not call back into it.
+             */
+            void setObserver(std::function<void(const Event&)> observer);
+
+            // Last value written to soft PWM channel @pin
+            int pwm(int pin);
+
+            // Sets the raw value the virtual ATMega sends for sensor @index
+            void setSensor(std::size_t index, unsigned char value);
+
+            // Last axes frame received, indexed by Commands::ATMega::Axes
+            std::vector<unsigned char> axes();
+            // Commands received by the virtual ATMega, in order
+            std::vector<unsigned char> commands();
+        };
+    }
+}
+
+#endif // SIM_CONTROLLER_H
@@ -0,0 +1,41 @@
+#include "Clock.h"
+
+#include <cerrno>
+#include <time.h>
+
+using namespace Politocean::RPi;
+
+namespace
+{
+    timespec toTimespec(Clock::time_point t)
+    {
+        long long ns = t.time_since_epoch().count();
+
+        timespec ts;
+        ts.tv_sec  = ns / 1000000000LL;
+        ts.tv_nsec = ns % 1000000000LL;
+
+        return ts;
+    }
+}
+
+Clock::time_point Clock::now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return time_point(duration(static_cast<long long>(ts.tv_sec) * 1000000000LL + ts.tv_nsec));
+}
+
+void Clock::sleepUntil(time_point deadline, duration spin)
+{
+    time_point wakeup = deadline - spin;
+
+    if (now() < wakeup)
+    {
+        timespec ts = toTimespec(wakeup);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) ;
+    }
+
+    while (now() < deadline) ;
+}
@@ -0,0 +1,36 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <chrono>
+
+namespace Politocean
+{
+    namespace RPi
+    {
+        /**
+         * Monotonic clock used to schedule GPIO edges against absolute deadlines.
+         * Time points are CLOCK_MONOTONIC nanoseconds, so they can be handed
+         * straight to clock_nanosleep(TIMER_ABSTIME).
+         */
+        class Clock
+        {
+        public:
+            typedef std::chrono::nanoseconds duration;
+            typedef std::chrono::time_point<Clock, duration> time_point;
+            typedef duration::rep rep;
+            typedef duration::period period;
+            static const bool is_steady = true;
+
+            static time_point now();
+
+            /**
+             * Sleeps until @deadline. If @spin is not zero the thread wakes up
+             * @spin earlier and busy-waits the remaining time, trading CPU for
+             * wakeup accuracy.
+             */
+            static void sleepUntil(time_point deadline, duration spin = duration::zero());
+        };
+    }
+}
+
+#endif // CLOCK_H
@@ -0,0 +1,346 @@
+#include "MotionScheduler.h"
+#include "Realtime.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace Politocean::RPi;
+
+MotionScheduler::~MotionScheduler()
+{
+    stopScheduling();
+
+    for (Stepper *stepper : steppers_)
+        stepper->scheduler_ = nullptr;
+}
+
+void MotionScheduler::add(Stepper &stepper)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    stepper.scheduler_ = this;
+    steppers_.push_back(&stepper);
+
+    due_.reserve(steppers_.size());
+}
+
+void MotionScheduler::start(Stepper &stepper)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (isInGroup(stepper))
+        return ;
+
+    stepper.cancel();
+    stepper.begin();
+
+    schedule(stepper);
+}
+
+void MotionScheduler::move(Stepper &stepper, long steps, bool relative)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (isInGroup(stepper))
+        return ;
+
+    stepper.aim(steps, relative);
+    stepper.begin();
+
+    schedule(stepper);
+}
+
+void MotionScheduler::schedule(Stepper &stepper)
+{
+    if (stepper.scheduled_)
+        return ;
+
+    stepper.scheduled_ = true;
+    edges_.push({ stepper.nextEdge_, &stepper });
+
+    cv_.notify_one();
+}
+
+bool MotionScheduler::moveTogether(const std::vector<Joint> &joints, bool relative)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (leader_)
+        return false;
+
+    for (const Joint &joint : joints)
+        if (joint.stepper->scheduler_ != this || joint.stepper->isStepping_)
+            return false;
+
+    // Steps of each joint, once its target is clamped to the soft limits
+    std::vector<long> steps;
+    Stepper *leader = nullptr;
+
+    for (const Joint &joint : joints)
+    {
+        Stepper &stepper = *joint.stepper;
+
+        steps.push_back(stepper.aim(joint.steps, relative) - stepper.position_);
+
+        if (!leader || std::labs(steps.back()) > leaderSteps_)
+        {
+            leader          = &stepper;
+            leaderSteps_    = std::labs(steps.back());
+        }
+    }
+
+    if (!leader || leaderSteps_ == 0)
+        return true;
+
+    int minVelocity = 0;
+    followers_.clear();
+
+    for (std::size_t i = 0; i < joints.size(); i++)
+    {
+        Stepper &stepper = *joints[i].stepper;
+
+        if (&stepper == leader)
+            continue ;
+
+        // Only the leader follows its target, the followers are stepped by follow()
+        stepper.cancel();
+
+        if (steps[i] == 0)
+            continue ;
+
+        long followerSteps = std::labs(steps[i]);
+
+        // Shortest period of the follower. Its steps are at least @gap leader steps apart,
+        // so the leader period can't be shorter than this period over @gap
+        Clock::duration period = std::chrono::microseconds(2 * stepper.requested_.velocity);
+        if (!stepper.ramp_.empty())
+            period = std::max(period, stepper.ramp_[stepper.ramp_.size() - 1]);
+
+        long long us    = std::chrono::duration_cast<std::chrono::microseconds>(period).count();
+        long gap        = leaderSteps_ / followerSteps;
+
+        minVelocity = std::max<long long>(minVelocity, (us + 2 * gap - 1) / (2 * gap));
+
+        stepper.writeDirection(steps[i] > 0 ? Direction::CW : Direction::CCW);
+        stepper.isStepping_ = true;
+
+        followers_.push_back({ &stepper, followerSteps, leaderSteps_ / 2, false });
+    }
+
+    leader->minVelocity_    = minVelocity;
+    leader_ = leader;
+
+    leader->begin();
+    schedule(*leader);
+
+    return true;
+}
+
+bool MotionScheduler::isCoordinated(Stepper &stepper)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    return isInGroup(stepper);
+}
+
+bool MotionScheduler::isInGroup(Stepper &stepper)
+{
+    if (!leader_)
+        return false;
+
+    if (&stepper == leader_)
+        return true;
+
+    for (const Follower &follower : followers_)
+        if (follower.stepper == &stepper)
+            return true;
+
+    return false;
+}
+
+void MotionScheduler::follow()
+{
+    GpioLines::Batch *batch = lines_ ? &batch_ : nullptr;
+
+    // The leader has just started a step
+    if (!leader_->stepHigh_)
+    {
+        for (Follower &follower : followers_)
+        {
+            follower.error += follower.steps;
+            follower.isLow  = follower.error >= leaderSteps_;
+
+            if (!follower.isLow)
+                continue ;
+
+            follower.error -= leaderSteps_;
+            follower.stepper->writeStep(Controller::PinLevel::PIN_LOW, batch);
+            follower.stepper->position_ += follower.stepper->sign_;
+        }
+
+        return ;
+    }
+
+    for (Follower &follower : followers_)
+    {
+        if (!follower.isLow)
+            continue ;
+
+        follower.stepper->writeStep(Controller::PinLevel::PIN_HIGH, batch);
+        follower.isLow = false;
+    }
+}
+
+void MotionScheduler::release()
+{
+    for (const Follower &follower : followers_)
+        follower.stepper->isStepping_ = false;
+
+    followers_.clear();
+
+    leader_->minVelocity_ = 0;
+    leader_ = nullptr;
+}
+
+void MotionScheduler::stop(Stepper &stepper)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (isInGroup(stepper))
+        leader_->end();
+    else
+        stepper.end();
+}
+
+void MotionScheduler::setSpin(int spin)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    spin_ = std::chrono::microseconds(spin);
+}
+
+void MotionScheduler::setLines(GpioLines *lines, int batchWindow)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    lines_          = lines;
+    batchWindow_    = std::chrono::microseconds(batchWindow);
+}
+
+void MotionScheduler::fire(Stepper &stepper, Clock::time_point now)
+{
+    bool isLeader = &stepper == leader_;
+
+    if (stepper.edge(now, lines_ ? &batch_ : nullptr))
+    {
+        edges_.push({ stepper.nextEdge_, &stepper });
+
+        if (isLeader)
+            follow();
+    }
+    else
+    {
+        stepper.scheduled_ = false;
+
+        if (isLeader)
+            release();
+    }
+}
+
+void MotionScheduler::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (isRunning_)
+    {
+        if (edges_.empty())
+        {
+            cv_.wait(lock);
+            continue ;
+        }
+
+        Clock::time_point deadline  = edges_.top().deadline;
+        Clock::time_point now       = Clock::now();
+
+        // Sleep until the earliest edge, unless a stepper starts in the meantime
+        if (deadline - spin_ > now)
+        {
+            cv_.wait_for(lock, deadline - spin_ - now);
+            continue ;
+        }
+
+        if (deadline > now)
+        {
+            lock.unlock();
+            Clock::sleepUntil(deadline, spin_);
+            lock.lock();
+        }
+
+        now = Clock::now();
+
+        // Each stepper has at most one edge queued, so they are all taken before
+        // firing any: an edge due right away is never written in the same batch
+        Clock::time_point last = lines_ ? now + batchWindow_ : now;
+
+        due_.clear();
+        do
+        {
+            due_.push_back(edges_.top());
+            edges_.pop();
+        } while (!edges_.empty() && edges_.top().deadline <= last);
+
+        for (const Edge &edge : due_)
+        {
+            lateness_.record(now - edge.deadline);
+            fire(*edge.stepper, now);
+        }
+
+        if (lines_)
+        {
+            lines_->write(batch_);
+            batch_.clear();
+        }
+    }
+}
+
+void MotionScheduler::startScheduling()
+{
+    if (isRunning_)
+        return ;
+
+    isRunning_ = true;
+    th_ = new std::thread([&]() {
+        Realtime::apply(Realtime::MOTION);
+        run();
+    });
+}
+
+void MotionScheduler::stopScheduling()
+{
+    if (!isRunning_)
+        return ;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isRunning_ = false;
+        cv_.notify_one();
+    }
+
+    th_->join();
+    delete th_;
+    th_ = nullptr;
+
+    // A coordinated move cut short leaves its followers free
+    if (leader_)
+        release();
+}
+
+bool MotionScheduler::isScheduling()
+{
+    return isRunning_;
+}
+
+Politocean::Histogram& MotionScheduler::lateness()
+{
+    return lateness_;
+}
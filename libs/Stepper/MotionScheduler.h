@@ -0,0 +1,149 @@
+#ifndef MOTION_SCHEDULER_H
+#define MOTION_SCHEDULER_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "Clock.h"
+#include "Histogram.h"
+#include "Stepper.h"
+
+namespace Politocean
+{
+    namespace RPi
+    {
+        /**
+         * Emits the step edges of all the registered steppers from a single thread.
+         * Pending edges are kept in a min-heap ordered by deadline, so the thread
+         * only wakes up when the earliest edge is due.
+         * With setLines(), the edges due within @batchWindow_ of each other are written
+         * together, with a single GpioLines::write().
+         * Coordinated moves run in the same loop: only the leader has edges queued,
+         * the followers step along with it.
+         */
+        class MotionScheduler
+        {
+            struct Edge
+            {
+                Clock::time_point deadline;
+                Stepper *stepper;
+
+                bool operator>(const Edge &other) const { return deadline > other.deadline; }
+            };
+
+            std::priority_queue<Edge, std::vector<Edge>, std::greater<Edge>> edges_;
+            std::vector<Stepper *> steppers_;
+            // Edges fired together by run()
+            std::vector<Edge> due_;
+
+            std::mutex mutex_;
+            std::condition_variable cv_;
+
+            std::thread *th_;
+            bool isRunning_;
+
+            Clock::duration spin_;
+
+            GpioLines *lines_;
+            GpioLines::Batch batch_;
+            Clock::duration batchWindow_;
+
+            /**
+             * Joint of a coordinated move stepping along with the leader.
+             * @steps   : steps it takes over the whole move
+             * @error   : Bresenham accumulator, it steps each time it reaches the leader steps
+             * @isLow   : it has started a step with the current leader step
+             */
+            struct Follower
+            {
+                Stepper *stepper;
+                long steps, error;
+                bool isLow;
+            };
+
+            /**
+             * @leader_         : joint timing the coordinated move, nullptr if there is none
+             * @leaderSteps_    : steps of the leader over the whole move
+             */
+            Stepper *leader_;
+            long leaderSteps_;
+            std::vector<Follower> followers_;
+
+            // Delay of each edge over its deadline
+            Histogram lateness_;
+
+            void run();
+
+            // Queues the first edge of @stepper, if it has none pending
+            void schedule(Stepper &stepper);
+            // Emits the next edge of @stepper and queues the following one
+            void fire(Stepper &stepper, Clock::time_point now);
+
+            // Steps the followers along the edge just emitted by the leader
+            void follow();
+            // Ends the coordinated move
+            void release();
+            bool isInGroup(Stepper &stepper);
+
+        public:
+            static const int DEFAULT_BATCH_WINDOW = 5;
+
+            MotionScheduler() :
+                th_(nullptr), isRunning_(false), spin_(Clock::duration::zero()),
+                lines_(nullptr), batchWindow_(std::chrono::microseconds(DEFAULT_BATCH_WINDOW)),
+                leader_(nullptr), leaderSteps_(0) {}
+            ~MotionScheduler();
+
+            // Hands the timing of @stepper over to the scheduler
+            void add(Stepper &stepper);
+
+            void start(Stepper &stepper);
+            void stop(Stepper &stepper);
+            // Moves @stepper to @steps, or by @steps if @relative (see Stepper::moveTo())
+            void move(Stepper &stepper, long steps, bool relative);
+
+            // Joint of a coordinated move, with its position or the steps to take
+            struct Joint
+            {
+                Stepper *stepper;
+                long steps;
+            };
+
+            /**
+             * Moves all the @joints together to their positions, or by their steps if @relative,
+             * clamped to their soft limits. The joint with the most steps to take leads with its
+             * ramp, and the others step along with it, Bresenham style, so all of them start and
+             * end together. The leader is slowed down so that no joint goes faster than its
+             * velocity, nor than the top speed of its ramp.
+             * Until the move ends, start() and move() are ignored for the joints, and stop()
+             * on any of them stops all of them along the ramp of the leader.
+             * Returns false, moving nothing, if a joint is not in the scheduler or is moving.
+             */
+            bool moveTogether(const std::vector<Joint> &joints, bool relative);
+            // Whether @stepper leads or follows the coordinated move in progress
+            bool isCoordinated(Stepper &stepper);
+
+            void setSpin(int spin);
+
+            /**
+             * Writes the step pins through @lines, batching the edges due within @batchWindow
+             * microseconds of each other, which are brought forward to the first of them.
+             * To be called before startScheduling().
+             */
+            void setLines(GpioLines *lines, int batchWindow = DEFAULT_BATCH_WINDOW);
+
+            void startScheduling();
+            void stopScheduling();
+
+            bool isScheduling();
+
+            Histogram& lateness();
+        };
+    }
+}
+
+#endif // MOTION_SCHEDULER_H
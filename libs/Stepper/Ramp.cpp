@@ -0,0 +1,100 @@
+#include "Ramp.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace Politocean::RPi;
+
+namespace
+{
+    /**
+     * Position reached at time @t by a jerk limited ramp to @vmax.
+     * @j is the jerk, @a the peak acceleration, @tj the duration of each jerk
+     * phase and @ta the duration of the constant acceleration phase.
+     * With @tj equal to zero it degenerates into a constant acceleration ramp.
+     */
+    double position(double t, double j, double a, double tj, double ta)
+    {
+        double x1 = j * tj * tj * tj / 6;
+        double v1 = a * tj / 2;
+
+        if (t <= tj)
+            return j * t * t * t / 6;
+
+        t -= tj;
+        if (t <= ta)
+            return x1 + v1 * t + a * t * t / 2;
+
+        double x2 = x1 + v1 * ta + a * ta * ta / 2;
+        double v2 = v1 + a * ta;
+
+        t -= ta;
+        return x2 + v2 * t + a * t * t / 2 - j * t * t * t / 6;
+    }
+}
+
+void Ramp::compute(double maxRate, double acceleration, double jerk)
+{
+    periods_.clear();
+
+    if (maxRate <= 0 || acceleration <= 0)
+        return ;
+
+    double a  = acceleration;
+    double tj = 0;
+
+    if (jerk > 0)
+    {
+        a  = std::min(acceleration, std::sqrt(maxRate * jerk));
+        tj = a / jerk;
+    }
+
+    double ta       = (maxRate - a * tj) / a;
+    double duration = 2 * tj + ta;
+    std::size_t steps = static_cast<std::size_t>(position(duration, jerk, a, tj, ta));
+
+    Clock::duration minPeriod(static_cast<Clock::rep>(1e9 / maxRate));
+
+    // Find when each step is reached by bisection, the ramp being monotonic
+    double previous = 0;
+    for (std::size_t i = 1; i <= steps; i++)
+    {
+        double lo = previous, hi = duration;
+        for (int k = 0; k < 64; k++)
+        {
+            double mid = (lo + hi) / 2;
+            if (position(mid, jerk, a, tj, ta) < i)
+                lo = mid;
+            else
+                hi = mid;
+        }
+
+        Clock::duration period(static_cast<Clock::rep>((hi - previous) * 1e9));
+        periods_.push_back(std::max(period, minPeriod));
+
+        previous = hi;
+    }
+
+    if (periods_.empty() || periods_.back() > minPeriod)
+        periods_.push_back(minPeriod);
+}
+
+void Ramp::clear()
+{
+    periods_.clear();
+}
+
+bool Ramp::empty() const
+{
+    return periods_.empty();
+}
+
+std::size_t Ramp::size() const
+{
+    return periods_.size();
+}
+
+Clock::duration Ramp::operator[](std::size_t step) const
+{
+    return periods_[step];
+}
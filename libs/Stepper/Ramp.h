@@ -0,0 +1,42 @@
+#ifndef RAMP_H
+#define RAMP_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Clock.h"
+
+namespace Politocean
+{
+    namespace RPi
+    {
+        /**
+         * Acceleration ramp of a stepper, stored as the period of every step
+         * taken from rest up to the maximum rate. The table is computed once,
+         * so the stepping loop only indexes it: accelerating walks it forward,
+         * decelerating walks it backwards.
+         */
+        class Ramp
+        {
+            std::vector<Clock::duration> periods_;
+
+        public:
+            /**
+             * @maxRate         : top speed in steps/s
+             * @acceleration    : steps/s^2, a non positive value disables the ramp
+             * @jerk            : steps/s^3, a non positive value gives a trapezoidal
+             *                    profile, otherwise an S-curve
+             */
+            void compute(double maxRate, double acceleration, double jerk = 0);
+            void clear();
+
+            bool empty() const;
+            std::size_t size() const;
+
+            // Period of the step taken after @step steps from rest
+            Clock::duration operator[](std::size_t step) const;
+        };
+    }
+}
+
+#endif // RAMP_H
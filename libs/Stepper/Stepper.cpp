@@ -1,8 +1,21 @@
 #include "Stepper.h"
+#include "MotionScheduler.h"
+
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 
 using namespace Politocean::RPi;
 
+Stepper::~Stepper()
+{
+    // Ends the stepping loop right away, so the worker can be joined
+    if (!scheduler_)
+        isStepping_ = false;
+
+    worker_.stop();
+}
+
 void Stepper::setup()
 {
     controller_->pinMode(enPin_, Controller::PinMode::PIN_OUTPUT);
@@ -12,60 +25,382 @@ void Stepper::setup()
     disable();
 }
 
+void Stepper::setLines(GpioLines *lines)
+{
+    lines_ = lines;
+}
+
+void Stepper::write(int pin, Controller::PinLevel level)
+{
+    if (lines_)
+        lines_->write(pin, level);
+    else
+        controller_->digitalWrite(pin, level);
+}
+
+void Stepper::writeStep(Controller::PinLevel level, GpioLines::Batch *batch)
+{
+    if (!batch || !batch->add(stepPin_, level))
+        write(stepPin_, level);
+}
+
 void Stepper::enable()
 {
-    controller_->digitalWrite(enPin_, Controller::PinLevel::PIN_LOW);
+    write(enPin_, Controller::PinLevel::PIN_LOW);
 }
 
 void Stepper::disable()
 {
-    controller_->digitalWrite(enPin_, Controller::PinLevel::PIN_HIGH);
+    write(enPin_, Controller::PinLevel::PIN_HIGH);
 }
 
 void Stepper::setDirection(Direction direction)
 {
-    direction_ = direction;
-
-    if (direction_ == Direction::CCW)
-        controller_->digitalWrite(dirPin_, Controller::PinLevel::PIN_LOW);
-    else if (direction_ == Direction::CW)
-        controller_->digitalWrite(dirPin_, Controller::PinLevel::PIN_HIGH);
-    else return ;
+    requested_.direction = direction;
+    control_.store(requested_);
 }
 
 void Stepper::setVelocity(int velocity)
 {
-    velocity_ = velocity;
+    requested_.velocity = velocity;
+    control_.store(requested_);
 }
 
-void Stepper::step()
-{   
-    controller_->digitalWrite(stepPin_, Controller::PinLevel::PIN_LOW);
-    std::this_thread::sleep_for(std::chrono::microseconds(velocity_));
+void Stepper::writeDirection(Direction direction)
+{
+    if (direction == Direction::CCW)
+    {
+        write(dirPin_, Controller::PinLevel::PIN_LOW);
+        sign_ = -1;
+    }
+    else if (direction == Direction::CW)
+    {
+        write(dirPin_, Controller::PinLevel::PIN_HIGH);
+        sign_ = 1;
+    }
+}
 
-    controller_->digitalWrite(stepPin_, Controller::PinLevel::PIN_HIGH);
-    std::this_thread::sleep_for(std::chrono::microseconds(velocity_));
+void Stepper::setSpin(int spin)
+{
+    spin_ = std::chrono::microseconds(spin);
 }
 
-void Stepper::startStepping()
+void Stepper::setProfile(double maxRate, double acceleration, double jerk)
+{
+    ramp_.compute(maxRate, acceleration, jerk);
+    rampStep_ = 0;
+}
+
+Clock::duration Stepper::nextPeriod()
+{
+    Clock::duration target = std::chrono::microseconds(2 * std::max(velocity_, minVelocity_));
+
+    if (ramp_.empty())
+        return target;
+
+    // Accelerate while the ramp is slower than the target
+    if (!isStopping_ && !isBraking_ && rampStep_ < ramp_.size() && ramp_[rampStep_] >= target)
+        return ramp_[rampStep_++];
+
+    // Decelerate when stopping or braking, or when the target has been lowered
+    if (rampStep_ > 0 && (isStopping_ || isBraking_ || ramp_[rampStep_ - 1] < target))
+        return ramp_[--rampStep_];
+
+    return rampStep_ > 0 ? std::max(target, ramp_[rampStep_ - 1]) : target;
+}
+
+void Stepper::begin()
 {
+    isStopping_ = false;
+
     if (isStepping_)
-        return;
+        return ;
 
+    rampStep_   = 0;
+    isBraking_  = false;
+    stepHigh_   = true;
+    nextEdge_   = Clock::now();
     isStepping_ = true;
-    th_ = new std::thread([&] {
-        while (isStepping_)
-            step();
-    });
+}
 
+void Stepper::end()
+{
+    cancel();
+
+    if (ramp_.empty())
+        isStepping_ = false;
+    else
+        isStopping_ = true;
 }
 
-void Stepper::stopStepping()
+/**
+ * Called before each step, returns false if the stepper must stop instead.
+ * It picks up the latest setDirection() and setVelocity(), then brakes when the
+ * steps left to the target or to the soft limit are no more than the steps needed
+ * to slow down along the ramp, so the stepper stops right there.
+ * The direction is only reversed once at ramp speed.
+ */
+bool Stepper::plan()
+{
+    if (control_.version() != controlVersion_)
+    {
+        Control control = control_.load(controlVersion_);
+
+        direction_      = control.direction;
+        velocity_       = control.velocity;
+        target_         = control.target;
+        hasTarget_      = control.hasTarget;
+        minPosition_    = control.minPosition;
+        maxPosition_    = control.maxPosition;
+        hasLimits_      = control.hasLimits;
+    }
+
+    Direction wanted = direction_;
+    bool braking = false;
+
+    if (hasTarget_)
+    {
+        long left = target_ - position_;
+
+        if (left == 0)
+        {
+            hasTarget_ = false;
+            return false;
+        }
+
+        wanted  = left > 0 ? Direction::CW : Direction::CCW;
+        braking = std::labs(left) <= static_cast<long>(rampStep_);
+    }
+
+    if (wanted != Direction::NONE && (wanted == Direction::CW ? 1 : -1) != sign_)
+    {
+        if (rampStep_ == 0)
+            writeDirection(wanted);
+        else
+            braking = true;
+    }
+
+    if (hasLimits_)
+    {
+        long room = sign_ > 0 ? maxPosition_ - position_ : position_ - minPosition_;
+
+        if (room <= 0)
+        {
+            hasTarget_ = false;
+            return false;
+        }
+
+        if (room <= static_cast<long>(rampStep_))
+            braking = true;
+    }
+
+    isBraking_ = braking;
+
+    return !(isStopping_ && rampStep_ == 0);
+}
+
+bool Stepper::proceed()
+{
+    // The scheduler makes its own decisions under its lock
+    std::unique_lock<std::mutex> lock(runMutex_, std::defer_lock);
+    if (!scheduler_)
+        lock.lock();
+
+    if (!isStepping_)
+        return false;
+
+    if (plan())
+        return true;
+
+    isStepping_ = isStopping_ = false;
+    return false;
+}
+
+bool Stepper::edge(Clock::time_point now, GpioLines::Batch *batch)
+{
+    if (!isStepping_)
+        return false;
+
+    if (stepHigh_)
+    {
+        if (!proceed())
+            return false;
+
+        halfPeriod_ = nextPeriod() / 2;
+        position_ += sign_;
+    }
+
+    writeStep(stepHigh_ ? Controller::PinLevel::PIN_LOW : Controller::PinLevel::PIN_HIGH, batch);
+
+    stepHigh_  = !stepHigh_;
+    nextEdge_ += halfPeriod_;
+
+    Clock::duration late = now - nextEdge_;
+
+    // Less than a half-period late: fire the next edge right away and catch up.
+    // More than that: drop the missed edges and restart from now, so the motor
+    // never gets a burst of pulses it could stall on.
+    if (late > halfPeriod_)
+    {
+        if (halfPeriod_ > Clock::duration::zero())
+            missedEdges_ += late / halfPeriod_;
+        nextEdge_ = now;
+    }
+
+    return true;
+}
+
+void Stepper::step()
 {
+    if (isStepping_)
+        return ;
+
+    worker_.park();
+
+    begin();
+    for (int i = 0; i < 2 && edge(Clock::now()); i++)
+        Clock::sleepUntil(nextEdge_, spin_);
+
     isStepping_ = false;
 }
 
+void Stepper::startStepping()
+{
+    if (scheduler_)
+    {
+        scheduler_->start(*this);
+        return ;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(runMutex_);
+
+        cancel();
+
+        if (isStepping_)
+        {
+            isStopping_ = false;
+            return ;
+        }
+    }
+
+    run();
+}
+
+void Stepper::run()
+{
+    // The loop of the previous run may still be returning, e.g. after an instant stop,
+    // and begin() resets the state it reads
+    worker_.park();
+
+    begin();
+    worker_.unpark();
+}
+
+void Stepper::loop()
+{
+    while (edge(Clock::now()))
+        Clock::sleepUntil(nextEdge_, spin_);
+}
+
+void Stepper::stopStepping()
+{
+    if (scheduler_)
+    {
+        scheduler_->stop(*this);
+        return ;
+    }
+
+    std::lock_guard<std::mutex> lock(runMutex_);
+    end();
+}
+
+long Stepper::aim(long steps, bool relative)
+{
+    long target = steps;
+    if (relative)
+        target += requested_.hasTarget ? requested_.target : position_.load();
+
+    if (requested_.hasLimits)
+        target = std::min(std::max(target, requested_.minPosition), requested_.maxPosition);
+
+    requested_.target       = target;
+    requested_.hasTarget    = true;
+    control_.store(requested_);
+
+    return target;
+}
+
+void Stepper::cancel()
+{
+    requested_.hasTarget = false;
+    control_.store(requested_);
+}
+
+void Stepper::move(long steps, bool relative)
+{
+    if (scheduler_)
+    {
+        scheduler_->move(*this, steps, relative);
+        return ;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(runMutex_);
+
+        aim(steps, relative);
+
+        if (isStepping_)
+        {
+            isStopping_ = false;
+            return ;
+        }
+    }
+
+    run();
+}
+
+void Stepper::moveTo(long position)
+{
+    move(position, false);
+}
+
+void Stepper::moveBy(long steps)
+{
+    move(steps, true);
+}
+
+void Stepper::setLimits(long minPosition, long maxPosition)
+{
+    requested_.minPosition  = minPosition;
+    requested_.maxPosition  = maxPosition;
+    requested_.hasLimits    = true;
+    control_.store(requested_);
+}
+
+void Stepper::clearLimits()
+{
+    requested_.hasLimits = false;
+    control_.store(requested_);
+}
+
+long Stepper::position()
+{
+    return position_;
+}
+
+void Stepper::setPosition(long position)
+{
+    position_ = position;
+    cancel();
+}
+
 bool Stepper::isStepping()
 {
     return isStepping_;
-}
\ No newline at end of file
+}
+
+unsigned long Stepper::missedEdges()
+{
+    return missedEdges_;
+}
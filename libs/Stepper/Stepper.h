@@ -1,46 +1,212 @@
 #ifndef STEPPER_H
 #define STEPPER_H
 
-#include <thread>
+#include <atomic>
+#include <mutex>
 
+#include "Clock.h"
+#include "Ramp.h"
+#include "SeqLock.h"
 #include "Direction.h"
 #include "Controller.h"
+#include "GpioLines.h"
+#include "Worker.h"
 
 namespace Politocean
 {
     namespace RPi
     {
+        class MotionScheduler;
+
         class Stepper
         {
+            friend class MotionScheduler;
+
             Controller *controller_;
+            // Lines driving the pins instead of @controller_, if not nullptr
+            GpioLines *lines_;
             
             int enPin_, dirPin_, stepPin_;
-            
+
+            /**
+             * Direction and half period in us requested with setDirection() and setVelocity(),
+             * the target of the move requested with moveTo() and moveBy(), while @hasTarget,
+             * and the soft limits set with setLimits(), while @hasLimits
+             */
+            struct Control
+            {
+                Direction direction;
+                int velocity;
+                long target;
+                bool hasTarget;
+                long minPosition, maxPosition;
+                bool hasLimits;
+            };
+
+            /**
+             * @control_        : latest Control, written by the caller of the motion methods and picked
+             *                    up by the stepping thread before each step; its version is the
+             *                    sequence number of the requests
+             * @requested_      : copy of the latest Control, used only by the writer
+             * @controlVersion_ : version of @control_ last picked up
+             * @direction_      : direction being followed, used only by the stepping thread
+             * @velocity_
+             * @minVelocity_    : lower bound of @velocity_ set by MotionScheduler::moveTogether()
+             *                    while the stepper leads a coordinated move, 0 otherwise
+             */
+            SeqLock<Control> control_;
+            Control requested_;
+            unsigned controlVersion_;
+
             Direction direction_;
-            int velocity_;
+            int velocity_, minVelocity_;
+
+            /**
+             * @position_       : steps taken from the origin, CW positive
+             * @sign_           : +1 while the direction pin is set for CW, -1 for CCW, 0 until it is first written
+             * @isBraking_      : decelerating to reverse, or to stop at the target or at a soft limit
+             * @target_         : position the stepper is moving to, while @hasTarget_, picked up from @control_
+             * @minPosition_    : soft limits, never crossed while @hasLimits_, picked up from @control_
+             * @maxPosition_
+             */
+            std::atomic<long> position_;
+            int sign_;
+            bool isBraking_;
+            long target_;
+            bool hasTarget_;
+            long minPosition_, maxPosition_;
+            bool hasLimits_;
+
+            // Written by the callers of the motion methods as well as by the stepping thread or the scheduler
+            std::atomic<bool> isStepping_, isStopping_;
+
+            /**
+             * @scheduler_  : scheduler emitting the edges, nullptr if the stepper runs its own thread
+             * @scheduled_  : true while the stepper has an edge queued in @scheduler_
+             */
+            MotionScheduler *scheduler_;
+            bool scheduled_;
+
+            /**
+             * @ramp_       : acceleration profile, empty if the stepper starts and stops at full speed
+             * @rampStep_   : current position along @ramp_
+             */
+            Ramp ramp_;
+            std::size_t rampStep_;
 
-            std::thread *th_;
-            bool isStepping_;
+            /**
+             * @nextEdge_       : absolute deadline of the next step pin edge
+             * @halfPeriod_     : time between the edges of the current step
+             * @stepHigh_       : level of the step pin after the last edge
+             * @spin_           : final part of each wait spent busy-waiting
+             * @missedEdges_    : edges dropped because the thread woke up too late
+             */
+            Clock::time_point nextEdge_;
+            Clock::duration halfPeriod_;
+            bool stepHigh_;
+            Clock::duration spin_;
+            std::atomic<unsigned long> missedEdges_;
+
+            /**
+             * Without a scheduler, @runMutex_ makes the start and stop decisions of the callers
+             * and the ones of the stepping loop mutually exclusive, so a start is never lost
+             * to a loop deciding to stop at the same time.
+             */
+            std::mutex runMutex_;
+
+            // Runs the stepping loop when the stepper has no scheduler, parked in between
+            Worker worker_;
+
+            Clock::duration nextPeriod();
+
+            void begin();
+            void end();
+            void write(int pin, Controller::PinLevel level);
+            // Writes the step pin, or adds it to @batch if given
+            void writeStep(Controller::PinLevel level, GpioLines::Batch *batch);
+            void writeDirection(Direction direction);
+            bool plan();
+            // Plans the next step, or stops the stepper and returns false
+            bool proceed();
+            // Adds the step pin change to @batch instead of writing it, if given
+            bool edge(Clock::time_point now, GpioLines::Batch *batch = nullptr);
+
+            /**
+             * Requests a move to @steps, from the requested target or the position if @relative,
+             * and returns the target once clamped to the soft limits
+             */
+            long aim(long steps, bool relative);
+            // Requests the move in progress, if any, to be dropped
+            void cancel();
+            void move(long steps, bool relative);
+            // Starts the stepping loop, once the one of the previous run has returned
+            void run();
+            void loop();
         
         public:
-            Stepper(Controller *controller, int enPin, int dirPin, int stepPin) : controller_(controller), enPin_(enPin), dirPin_(dirPin), stepPin_(stepPin), isStepping_(false) {}
+            Stepper(Controller *controller, int enPin, int dirPin, int stepPin) :
+                controller_(controller), lines_(nullptr), enPin_(enPin), dirPin_(dirPin), stepPin_(stepPin), control_(Control{ Direction::NONE, 0, 0, false, 0, 0, false }),
+                requested_{ Direction::NONE, 0, 0, false, 0, 0, false }, controlVersion_(0), direction_(Direction::NONE), velocity_(0), minVelocity_(0),
+                position_(0), sign_(0), isBraking_(false), target_(0), hasTarget_(false), minPosition_(0), maxPosition_(0), hasLimits_(false),
+                isStepping_(false), isStopping_(false),
+                scheduler_(nullptr), scheduled_(false), rampStep_(0), stepHigh_(true), spin_(Clock::duration::zero()), missedEdges_(0),
+                worker_(Realtime::MOTION, [this]() { loop(); }) {}
+            ~Stepper();
             
             void setup();
+            // Drives the pins through @lines from now on, to be called with the stepper still
+            void setLines(GpioLines *lines);
 
             void enable();
             void disable();
             
+            /**
+             * Both can be called while stepping, without locks: the new values are picked up
+             * before the next step. A running stepper decelerates along the ramp before reversing,
+             * and a new velocity is reached along the ramp too.
+             */
             void setDirection(Direction direction);
             void setVelocity(int velocity);
+            void setSpin(int spin);
+
+            /**
+             * Sets the acceleration profile used by startStepping() and stopStepping().
+             * @maxRate in steps/s, @acceleration in steps/s^2, @jerk in steps/s^3.
+             * A zero @acceleration restores the instant start/stop behaviour,
+             * a zero @jerk gives a trapezoidal profile instead of an S-curve.
+             */
+            void setProfile(double maxRate, double acceleration, double jerk = 0);
 
             void step();
 
             void startStepping();
             void stopStepping();
 
+            /**
+             * Moves to an absolute position, or by a number of steps from the current target
+             * if a move is in progress or from the current position otherwise.
+             * The whole move runs on the stepper thread, with the acceleration profile,
+             * at the speed set by setVelocity(). stopStepping() cancels it.
+             */
+            void moveTo(long position);
+            void moveBy(long steps);
+
+            /**
+             * Soft limits, in steps from the origin.
+             * Moves are clamped to them, and the stepper brakes before crossing them
+             * while running with startStepping().
+             */
+            void setLimits(long minPosition, long maxPosition);
+            void clearLimits();
+
+            long position();
+            // Redefines the current position, to be called with the stepper still
+            void setPosition(long position);
+
             bool isStepping();
+            unsigned long missedEdges();
         };
     }
 }
 
-#endif // STEPPER_H
\ No newline at end of file
+#endif // STEPPER_H
@@ -0,0 +1,556 @@
+/**
+ * @author pettinz
+ */
+
+#include "ATMega.h"
+#include "Realtime.h"
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+#include <CommandTable.h>
+
+#include "PolitoceanUtils.hpp"
+
+#include "Component.hpp"
+#include "ComponentsManager.hpp"
+
+#include "logger.h"
+
+#include "json.hpp"
+
+#include <Reflectables/Float.hpp>
+
+/***************************************************
+ * Sensors frame decoder
+ **************************************************/
+
+float SensorsDecoder::value(sensor_t sensor, unsigned char data)
+{
+	if (sensor == sensor_t::ROLL || sensor == sensor_t::PITCH)
+		return data / 10.0f;
+	else if (sensor == sensor_t::PRESSURE)
+		return data + 990;
+	else
+		return data;
+}
+
+bool SensorsDecoder::decode(unsigned char data, SensorsSample &sample)
+{
+	switch (state_)
+	{
+	case State::DELIMITER:
+		if (data == Commands::ATMega::SPI::Delims::SENSORS)
+			state_ = State::LENGTH;
+		return false;
+
+	case State::LENGTH:
+		if (data != SENSORS_COUNT)
+		{
+			// The delimiter was a value byte: resync on this byte if it is a delimiter
+			if (data != Commands::ATMega::SPI::Delims::SENSORS)
+				state_ = State::DELIMITER;
+			return false;
+		}
+
+		received_ = 0;
+		checksum_ = data;
+		state_ = State::DATA;
+		return false;
+
+	case State::DATA:
+		data_[received_++] = data;
+		checksum_ += data;
+
+		if (received_ == SENSORS_COUNT)
+			state_ = State::CHECKSUM;
+		return false;
+
+	case State::CHECKSUM:
+		state_ = State::DELIMITER;
+
+		if (data != checksum_)
+		{
+			dropped_++;
+			return false;
+		}
+
+		for (std::size_t i = 0; i < SENSORS_COUNT; i++)
+			sample.values[i] = value(static_cast<sensor_t>(i), data_[i]);
+
+		sample.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+		return true;
+	}
+
+	return false;
+}
+
+unsigned long SensorsDecoder::dropped()
+{
+	return dropped_;
+}
+
+/***************************************************
+ * Listener class for subscriber
+ **************************************************/
+
+void Listener::setRecorder(Capture::Recorder *recorder)
+{
+	recorder_ = recorder;
+}
+
+void Listener::listenForAxes(Types::Vector<int> payload)
+{
+	if (recorder_)
+	{
+		// Recorded as the JSON array it has been parsed from
+		std::string text = "[";
+		for (std::size_t i = 0; i < payload.size(); i++)
+			text += (i ? "," : "") + std::to_string(payload[i]);
+
+		recorder_->message(Topics::AXES, text + "]");
+	}
+
+	AxesSample axes = {};
+
+	for (std::size_t i = 0; i < payload.size() && i < Commands::ATMega::Axes::COUNT; i++)
+		axes.values[i] = payload[i];
+	axes.received = std::chrono::steady_clock::now();
+
+	storeAxes(axes);
+}
+
+void Listener::listenForAxesBinary(const std::string &payload)
+{
+	std::chrono::steady_clock::time_point received = std::chrono::steady_clock::now();
+	AxesPayload::Axes decoded;
+
+	if (recorder_)
+		recorder_->message(Topics::AXES_BINARY, payload);
+
+	if (!AxesPayload::decode(payload, decoded))
+	{
+		droppedAxes_++;
+		return;
+	}
+
+	// Duplicated or reordered payloads would move the ROV back to older axes
+	std::int32_t delta = static_cast<std::int32_t>(decoded.sequence - axesSequence_);
+	bool isRestarted = received - axesAccepted_ > AxesOrdering::RESYNC || delta < -static_cast<std::int32_t>(AxesOrdering::MAX_REORDER);
+
+	if (hasAxesSequence_ && delta <= 0 && !isRestarted)
+	{
+		droppedAxes_++;
+		return;
+	}
+
+	hasAxesSequence_ = true;
+	axesSequence_ = decoded.sequence;
+	axesAccepted_ = received;
+
+	AxesSample axes;
+	std::copy(decoded.values, decoded.values + Commands::ATMega::Axes::COUNT, axes.values);
+	axes.received = received;
+
+	storeAxes(axes);
+}
+
+void Listener::storeAxes(const AxesSample &axes)
+{
+	axes_.store(axes);
+	notifyBus();
+
+	axesCallbacks_.record(std::chrono::steady_clock::now() - axes.received);
+}
+
+void Listener::notifyBus()
+{
+	// Taking the lock prevents the notification from slipping between the check and the wait of the SPI thread
+	std::lock_guard<std::mutex> lock(mutexBus_);
+	busCv_.notify_one();
+}
+
+void Listener::waitForBus(unsigned axesVersion, std::chrono::steady_clock::time_point deadline)
+{
+	std::unique_lock<std::mutex> lock(mutexBus_);
+	busCv_.wait_until(lock, deadline, [&]() { return !commands_.empty() || axes_.version() != axesVersion || isBusWoken_; });
+
+	isBusWoken_ = false;
+}
+
+void Listener::wakeUpBus()
+{
+	std::lock_guard<std::mutex> lock(mutexBus_);
+	isBusWoken_ = true;
+	busCv_.notify_one();
+}
+
+/**
+ * Text to identifier lookup for Topics::COMMANDS payloads.
+ * The payload texts are defined in politocean_common, so the table is sorted once at startup.
+ */
+const CommandTable<Commands::ATMega::Command> commandsTable({
+	{Commands::Actions::RESET, Commands::ATMega::Command::RESET},
+	{Commands::Actions::ON, Commands::ATMega::Command::ON},
+	{Commands::Actions::OFF, Commands::ATMega::Command::OFF},
+	{Commands::Actions::ATMega::VDOWN_ON, Commands::ATMega::Command::VDOWN_ON},
+	{Commands::Actions::ATMega::VDOWN_OFF, Commands::ATMega::Command::VDOWN_OFF},
+	{Commands::Actions::ATMega::VUP_ON, Commands::ATMega::Command::VUP_ON},
+	{Commands::Actions::ATMega::VUP_OFF, Commands::ATMega::Command::VUP_OFF},
+	{Commands::Actions::ATMega::VUP_FAST_ON, Commands::ATMega::Command::VUP_FAST_ON},
+	{Commands::Actions::ATMega::VUP_FAST_OFF, Commands::ATMega::Command::VUP_FAST_OFF},
+	{Commands::Actions::ATMega::FAST, Commands::ATMega::Command::FAST},
+	{Commands::Actions::ATMega::SLOW, Commands::ATMega::Command::SLOW},
+	{Commands::Actions::ATMega::MEDIUM, Commands::ATMega::Command::MEDIUM},
+	{Commands::Actions::ATMega::START_AND_STOP, Commands::ATMega::Command::START_AND_STOP},
+	{Commands::Actions::ATMega::PITCH_CONTROL, Commands::ATMega::Command::PITCH_CONTROL}},
+	Commands::ATMega::Command::NONE);
+
+void Listener::listenForCommands(const std::string &payload)
+{
+	std::chrono::steady_clock::time_point received = std::chrono::steady_clock::now();
+
+	if (recorder_)
+		recorder_->message(Topics::COMMANDS, payload);
+
+	Commands::ATMega::Command command = commandsTable.find(payload);
+
+	if (command == Commands::ATMega::Command::NONE)
+	{
+		droppedCommands_++;
+		logger::getInstance().log(logger::WARNING, "Unknown command, dropped.");
+		return;
+	}
+
+	if (!commands_.push({ command, received }))
+	{
+		droppedCommands_++;
+		logger::getInstance().log(logger::WARNING, "Commands queue full, command dropped.");
+		return;
+	}
+
+	notifyBus();
+
+	commandsCallbacks_.record(std::chrono::steady_clock::now() - received);
+}
+
+void Listener::listenForSensor(unsigned char data)
+{
+	SensorsSample sample;
+
+	if (!decoder_.decode(data, sample))
+		return;
+
+	sensors_.store(sample);
+
+	// Taking the lock prevents the notification from slipping between the check and the wait of the Talker
+	std::lock_guard<std::mutex> lock(mutexSnr_);
+	sensorsCv_.notify_all();
+}
+
+void Listener::waitForSensors(unsigned version, std::chrono::steady_clock::time_point deadline)
+{
+	std::unique_lock<std::mutex> lock(mutexSnr_);
+	sensorsCv_.wait_until(lock, deadline, [&]() { return sensors_.version() != version || isSensorsWoken_; });
+
+	isSensorsWoken_ = false;
+}
+
+void Listener::wakeUpSensors()
+{
+	std::lock_guard<std::mutex> lock(mutexSnr_);
+	isSensorsWoken_ = true;
+	sensorsCv_.notify_all();
+}
+
+AxesSample Listener::axes(unsigned &version)
+{
+	return axes_.load(version);
+}
+
+bool Listener::action(CommandSample &command)
+{
+	return commands_.pop(command);
+}
+
+SensorsSample Listener::sensors(unsigned &version)
+{
+	return sensors_.load(version);
+}
+
+bool Listener::isSensorsUpdated()
+{
+	return sensors_.version() != 0;
+}
+
+Histogram &Listener::axesCallbacks()
+{
+	return axesCallbacks_;
+}
+
+Histogram &Listener::commandsCallbacks()
+{
+	return commandsCallbacks_;
+}
+
+unsigned long Listener::droppedCommands()
+{
+	return droppedCommands_;
+}
+
+unsigned long Listener::droppedAxes()
+{
+	return droppedAxes_;
+}
+
+unsigned long Listener::droppedFrames()
+{
+	return decoder_.dropped();
+}
+
+/***************************************************
+ * Talker class for sensors
+ **************************************************/
+
+void Talker::startTalking(MqttClient &publisher, Listener &listener, Controller &controller)
+{
+	if (isTalking_)
+		return;
+
+	isTalking_ = true;
+	listener_ = &listener;
+
+	sensorThread_ = new std::thread([&]() {
+		Realtime::apply(Realtime::TALKER);
+
+		unsigned published = 0;
+		std::chrono::steady_clock::time_point lastPublish = std::chrono::steady_clock::now();
+
+		while (publisher.is_connected() && isTalking_)
+		{
+			listener.waitForSensors(published, lastPublish + maxStaleness_);
+			std::this_thread::sleep_until(lastPublish + minInterval_);
+
+			if (!listener.isSensorsUpdated())
+			{
+				lastPublish = std::chrono::steady_clock::now();
+				continue;
+			}
+
+			SensorsSample sample = listener.sensors(published);
+
+			nlohmann::json message;
+			message["values"]		= std::vector<float>(sample.values, sample.values + SENSORS_COUNT);
+			message["timestamp"]	= sample.timestamp;
+
+			publisher.publish(Topics::SENSORS, message.dump());
+
+			lastPublish = std::chrono::steady_clock::now();
+		}
+	});
+}
+
+void Talker::stopTalking()
+{
+	if (!isTalking_)
+		return;
+
+	isTalking_ = false;
+	listener_->wakeUpSensors();
+	sensorThread_->join();
+	delete sensorThread_;
+	sensorThread_ = nullptr;
+}
+
+bool Talker::isTalking()
+{
+	return isTalking_;
+}
+
+/***************************************************
+ * SPI Class
+ **************************************************/
+
+SPI::SPI(Controller &controller) : controller_(controller), link_(controller), busThread_(nullptr), isUsing_(false), listener_(nullptr),
+	interval_(Timing::Milliseconds::AXES_DELAY), recorder_(nullptr)
+{
+	long long threshold = (Timing::Milliseconds::SENSORS_UPDATE_DELAY / Timing::Milliseconds::AXES_DELAY) / (static_cast<int>(sensor_t::Last) + 1);
+	keepalive_ = std::chrono::milliseconds(threshold * Timing::Milliseconds::AXES_DELAY);
+}
+
+void SPI::setup()
+{
+	controller_.setupSPI(Controller::DEFAULT_SPI_CHANNEL, Controller::DEFAULT_SPI_SPEED);
+
+	if (!link_.setup(Controller::DEFAULT_SPI_CHANNEL, Controller::DEFAULT_SPI_SPEED))
+		logger::getInstance().log(logger::WARNING, "Can't open spidev, SPI frames will be sent byte by byte.");
+}
+
+void SPI::setRecorder(Capture::Recorder *recorder)
+{
+	recorder_ = recorder;
+}
+
+void SPI::startSPI(Listener &listener)
+{
+	if (isUsing_)
+		return;
+
+	isUsing_ = true;
+	listener_ = &listener;
+
+	busThread_ = new std::thread([&]() {
+		Realtime::apply(Realtime::BUS);
+
+		unsigned axesVersion = 0;
+		AxesSample axes = {};
+
+		std::chrono::steady_clock::time_point lastFrame = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::time_point lastAxes = lastFrame;
+
+		while (isUsing_)
+		{
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			CommandSample command;
+
+			if (listener.action(command))
+			{
+				sendCommand(command.command, listener);
+				latency_[COMMAND].record(std::chrono::steady_clock::now() - command.received);
+
+				lastFrame = std::chrono::steady_clock::now();
+				continue;
+			}
+
+			unsigned version;
+			AxesSample latest = listener.axes(version);
+
+			if (version != axesVersion && now >= lastAxes + interval_)
+			{
+				axes = latest;
+				axesVersion = version;
+
+				sendAxes(axes, AXES, listener);
+				latency_[AXES].record(std::chrono::steady_clock::now() - axes.received);
+
+				lastFrame = lastAxes = std::chrono::steady_clock::now();
+				continue;
+			}
+
+			if (now >= lastFrame + keepalive_)
+			{
+				sendAxes(axes, POLL, listener);
+				latency_[POLL].record(now - (lastFrame + keepalive_));
+
+				lastFrame = std::chrono::steady_clock::now();
+				continue;
+			}
+
+			// Sleep until the next slot: new axes still waiting for their interval, or the next poll
+			std::chrono::steady_clock::time_point next = lastFrame + keepalive_;
+			if (version != axesVersion)
+				next = std::min(next, lastAxes + interval_);
+
+			listener.waitForBus(version, next);
+		}
+	});
+}
+
+void SPI::stopSPI()
+{
+	if (!isUsing_)
+		return;
+
+	isUsing_ = false;
+	listener_->wakeUpBus();
+	busThread_->join();
+	delete busThread_;
+	busThread_ = nullptr;
+
+	const char *names[] = { "commands", "axes", "polls" };
+	for (int i = COMMAND; i < FRAME_CLASSES; i++)
+	{
+		Histogram::Snapshot frames = latency_[i].snapshot();
+
+		logger::getInstance().log(logger::DEBUG, std::string("SPI ") + names[i] + ": " + std::to_string(frames.count) +
+			" frames, mean latency " + std::to_string(frames.mean()) + " us, max " + std::to_string(frames.max / 1000) + " us");
+	}
+}
+
+void SPI::sendCommand(Commands::ATMega::Command command, Listener &listener)
+{
+	switch (command)
+	{
+	case Commands::ATMega::Command::NONE:
+		break;
+
+	case Commands::ATMega::Command::RESET:
+		controller_.reset();
+		break;
+
+	case Commands::ATMega::Command::ON:
+		ComponentsManager::SetComponentState(component_t::POWER, Component::Status::ENABLED);
+		controller_.startMotors();
+		break;
+
+	case Commands::ATMega::Command::OFF:
+		ComponentsManager::SetComponentState(component_t::POWER, Component::Status::DISABLED);
+		controller_.stopMotors();
+		break;
+
+	default:
+	{ // the command is for the spi
+		unsigned char frame[] = {
+			Commands::ATMega::SPI::Delims::COMMAND,
+			Commands::ATMega::SPI::CODES[static_cast<int>(command)]};
+		send(frame, sizeof(frame), COMMAND, listener);
+	}
+	}
+}
+
+void SPI::sendAxes(const AxesSample &sample, FrameClass frameClass, Listener &listener)
+{
+	const int *axes = sample.values;
+
+	unsigned char frame[] = {
+		(unsigned char)Commands::ATMega::SPI::Delims::AXES,
+		(unsigned char)Politocean::map(axes[Commands::ATMega::Axes::X_AXIS], SHRT_MIN, SHRT_MAX, 1, UCHAR_MAX - 1),
+		(unsigned char)Politocean::map(axes[Commands::ATMega::Axes::Y_AXIS], SHRT_MIN, SHRT_MAX, 1, UCHAR_MAX - 1),
+		(unsigned char)Politocean::map(axes[Commands::ATMega::Axes::RZ_AXIS], SHRT_MIN, SHRT_MAX, 1, UCHAR_MAX - 1),
+		(unsigned char)Politocean::map(axes[Commands::ATMega::Axes::PITCH_AXIS], SHRT_MIN, SHRT_MAX, 1, UCHAR_MAX - 1),
+	};
+
+	send(frame, sizeof(frame), frameClass, listener);
+}
+
+void SPI::send(unsigned char *frame, std::size_t length, FrameClass frameClass, Listener &listener)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// Polls depend only on the timing of the bus, and the transfer overwrites the frame
+	if (recorder_ && frameClass != POLL)
+		recorder_->output(Capture::Kind::SPI, frameClass, frame, length);
+
+	link_.transfer(frame, length);
+
+	for (std::size_t i = 0; i < length; i++)
+		listener.listenForSensor(frame[i]);
+
+	transfers_.record(std::chrono::steady_clock::now() - start);
+}
+
+Histogram &SPI::latency(FrameClass frameClass)
+{
+	return latency_[frameClass];
+}
+
+Histogram &SPI::transfers()
+{
+	return transfers_;
+}
+
+bool SPI::isUsing()
+{
+	return isUsing_;
+}
@@ -0,0 +1,311 @@
+/**
+ * @author pettinz
+ */
+
+#ifndef ATMEGA_H
+#define ATMEGA_H
+
+#include <string>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <Commands.h>
+#include <RingBuffer.h>
+#include <SeqLock.h>
+#include <Histogram.h>
+#include <AxesPayload.h>
+#include <RovTopics.h>
+
+#include "MqttClient.h"
+#include "Sensor.h"
+#include "Controller.h"
+#include "SPILink.h"
+#include "Capture.h"
+#include "PolitoceanConstants.h"
+
+#include <Reflectables/Vector.hpp>
+
+using namespace Politocean;
+using namespace Politocean::RPi;
+using namespace Politocean::Constants;
+
+/**
+ * Sensors publishing rate limits.
+ * A new sample is published as soon as it is received, but not more often than MIN_INTERVAL;
+ * if no sample arrives for MAX_STALENESS the last one is published again.
+ */
+namespace SensorsTiming
+{
+	const std::chrono::milliseconds MIN_INTERVAL(50);
+	const std::chrono::milliseconds MAX_STALENESS(Timing::Seconds::SENSORS * 1000);
+}
+
+/**
+ * Ordering of the binary axes payloads.
+ * A payload not newer than the last one accepted is dropped, unless the last one is older
+ * than RESYNC or the payload is more than MAX_REORDER behind it: the publisher has restarted
+ * its sequence, and its payloads must not be dropped until they catch up with the old one.
+ */
+namespace AxesOrdering
+{
+	const std::chrono::milliseconds RESYNC(500);
+	const std::uint32_t MAX_REORDER = 1024;
+}
+
+/***************************************************
+ * Sensors frame decoder
+ **************************************************/
+
+const std::size_t SENSORS_COUNT = static_cast<std::size_t>(sensor_t::Last) + 1;
+
+/**
+ * A complete set of sensor values, indexed by sensor_t.
+ * @timestamp is the capture time in milliseconds since the Unix epoch.
+ */
+struct SensorsSample
+{
+	float values[SENSORS_COUNT];
+	long long timestamp;
+};
+
+/**
+ * Decodes the sensors frames the ATMega sends back on MISO, one byte at a time.
+ * A frame is made of:
+ *	(*) the Delims::SENSORS delimiter
+ *	(*) the number of values, which must be SENSORS_COUNT
+ *	(*) one byte for each sensor, in sensor_t order
+ *	(*) the 8 bit sum of the number of values and of the values
+ * A frame with a wrong length or checksum is dropped as a whole and the decoder
+ * waits for the next delimiter.
+ */
+class SensorsDecoder
+{
+	enum class State { DELIMITER, LENGTH, DATA, CHECKSUM };
+
+	State state_;
+	unsigned char data_[SENSORS_COUNT];
+	std::size_t received_;
+	unsigned char checksum_;
+	std::atomic<unsigned long> dropped_;
+
+	static float value(sensor_t sensor, unsigned char data);
+
+public:
+	SensorsDecoder() : state_(State::DELIMITER), received_(0), checksum_(0), dropped_(0) {}
+
+	// Returns true if @data completes a valid frame, whose values are stored in @sample
+	bool decode(unsigned char data, SensorsSample &sample);
+
+	unsigned long dropped();
+};
+
+/***************************************************
+ * Listener class for subscriber
+ **************************************************/
+
+/**
+ * Joystick axes values, indexed by Commands::ATMega::Axes.
+ * @received is when they arrived from MQTT.
+ */
+struct AxesSample
+{
+	int values[Commands::ATMega::Axes::COUNT];
+	std::chrono::steady_clock::time_point received;
+};
+
+// A command waiting to be sent and when it arrived from MQTT
+struct CommandSample
+{
+	Commands::ATMega::Command command;
+	std::chrono::steady_clock::time_point received;
+};
+
+class Listener
+{
+	/**
+	 * @axes_		: latest joystick axes, written by the MQTT thread and read by the SPI thread.
+						Older values are simply overwritten.
+	 * @commands_	: commands received from the MQTT callback and not yet sent.
+						It is written only by the MQTT thread and read only by the SPI thread.
+	 */
+	SeqLock<AxesSample> axes_;
+	RingBuffer<CommandSample, 64> commands_;
+
+	/**
+	 * @decoder_	: assembles the sensors frames, used only by the SPI thread sending a frame
+	 * @sensors_	: last complete sample, published to the Talker without locks
+	 */
+	SensorsDecoder decoder_;
+	SeqLock<SensorsSample> sensors_;
+
+	// Signalled when a new sample is published, or by wakeUpSensors() setting @isSensorsWoken_
+	std::mutex mutexSnr_;
+	std::condition_variable sensorsCv_;
+	bool isSensorsWoken_;
+
+	// Signalled when new axes or commands are received, or by wakeUpBus() setting @isBusWoken_
+	std::mutex mutexBus_;
+	std::condition_variable busCv_;
+	bool isBusWoken_;
+
+	/**
+	 * @axesCallbacks_		: time spent in listenForAxes(), recorded by the MQTT thread
+	 * @commandsCallbacks_	: time spent in listenForCommands(), recorded by the MQTT thread
+	 * @droppedCommands_	: commands unknown or received with the queue full
+	 * @droppedAxes_		: binary axes payloads malformed or older than the last one
+	 * @axesSequence_		: sequence number of the last binary axes payload, used only by the MQTT thread
+	 * @axesAccepted_		: when it was accepted, used only by the MQTT thread
+	 */
+	Histogram axesCallbacks_, commandsCallbacks_;
+	std::atomic<unsigned long> droppedCommands_, droppedAxes_;
+
+	bool hasAxesSequence_;
+	std::uint32_t axesSequence_;
+	std::chrono::steady_clock::time_point axesAccepted_;
+
+	// Records the messages received, if set
+	Capture::Recorder *recorder_;
+
+	void storeAxes(const AxesSample &axes);
+
+	void notifyBus();
+
+public:
+	Listener() : isSensorsWoken_(false), isBusWoken_(false), droppedCommands_(0), droppedAxes_(0), hasAxesSequence_(false), axesSequence_(0), recorder_(nullptr) {}
+
+	// Records every message received into @recorder, to be set before subscribing
+	void setRecorder(Capture::Recorder *recorder);
+
+	// Returns the latest axes and their @version
+	AxesSample axes(unsigned &version);
+	// Pops the next command into @command, returns false if there is none
+	bool action(CommandSample &command);
+	// Returns a consistent copy of the last complete sensors sample and its @version
+	SensorsSample sensors(unsigned &version);
+
+	// Waits until a command or axes newer than @axesVersion are received, or @deadline expires
+	void waitForBus(unsigned axesVersion, std::chrono::steady_clock::time_point deadline);
+	// Ends the current or next waitForBus() right away, e.g. to stop the SPI thread
+	void wakeUpBus();
+	// Waits until a sample newer than @version is published or @deadline expires
+	void waitForSensors(unsigned version, std::chrono::steady_clock::time_point deadline);
+	// Ends the current or next waitForSensors() right away, e.g. to stop the Talker
+	void wakeUpSensors();
+
+	/**
+	 * Callback functions.
+	 * They read the joystick data (@payload) from CommandParser
+	 * 
+	 * @payload: the string that recives from the CommandParser
+	 * 
+	 * listenForButtons	: converts the string @payload into an unsigned char value and stores it inside @button_.
+	 * listenForAxes	: parses the string @payload into a JSON an stores the axes values inside @axes_ vector.
+	 * listenForAxesBinary	: decodes an AxesPayload into @axes_, without allocating.
+	 */
+	void listenForAxes(Types::Vector<int> payload);
+	void listenForAxesBinary(const std::string &payload);
+	void listenForCommands(const std::string &payload);
+	void listenForSensor(unsigned char data);
+
+	bool isSensorsUpdated();
+
+	Histogram &axesCallbacks();
+	Histogram &commandsCallbacks();
+
+	unsigned long droppedCommands();
+	unsigned long droppedAxes();
+	// Sensors frames dropped for a wrong length or checksum
+	unsigned long droppedFrames();
+};
+
+/***************************************************
+ * Talker class for sensors
+ **************************************************/
+
+class Talker
+{
+	std::thread *sensorThread_;
+	std::atomic<bool> isTalking_;
+	// Listener of the sensors thread, woken up by stopTalking()
+	Listener *listener_;
+
+	/**
+	 * @minInterval_	: minimum time between two sensors messages
+	 * @maxStaleness_	: maximum time without sensors messages, the last sample is sent again when it expires
+	 */
+	std::chrono::milliseconds minInterval_, maxStaleness_;
+
+public:
+	Talker(std::chrono::milliseconds minInterval, std::chrono::milliseconds maxStaleness) :
+		sensorThread_(nullptr), isTalking_(false), listener_(nullptr), minInterval_(minInterval), maxStaleness_(maxStaleness) {}
+
+	void startTalking(MqttClient &publisher, Listener &listener, Controller &controller);
+	void stopTalking();
+
+	bool isTalking();
+};
+
+/***************************************************
+ * SPI Class
+ **************************************************/
+
+/**
+ * Owns the SPI link to the ATMega and decides which frame goes on the bus next:
+ *	(*) COMMAND frames, sent as soon as a command is received
+ *	(*) AXES frames with the latest axes, sent when they change but at most once every AXES_DELAY
+ *	(*) POLL frames, the last axes sent again when the bus has been idle for @keepalive_,
+ *		since the ATMega can only send sensors back while we are sending
+ */
+class SPI
+{
+public:
+	enum FrameClass { COMMAND, AXES, POLL, FRAME_CLASSES };
+
+private:
+	Controller &controller_;
+	SPILink link_;
+
+	std::thread *busThread_;
+	std::atomic<bool> isUsing_;
+	// Listener of the bus thread, woken up by stopSPI()
+	Listener *listener_;
+
+	std::chrono::milliseconds interval_, keepalive_;
+
+	/**
+	 * Recorded by the bus thread:
+	 * @latency_	: for COMMAND and AXES frames the time from MQTT to the bus,
+	 *				  for POLL frames the delay over their scheduled slot
+	 * @transfers_	: duration of send(), transfer and sensors decoding
+	 */
+	Histogram latency_[FRAME_CLASSES];
+	Histogram transfers_;
+
+	// Records the COMMAND and AXES frames sent, with their class as channel, if set
+	Capture::Recorder *recorder_;
+
+	// Transfers the whole @frame in one transaction, then decodes the sensor bytes received
+	void send(unsigned char *frame, std::size_t length, FrameClass frameClass, Listener &listener);
+
+	void sendCommand(Commands::ATMega::Command command, Listener &listener);
+	void sendAxes(const AxesSample &axes, FrameClass frameClass, Listener &listener);
+
+public:
+	SPI(Controller &controller);
+
+	void setup();
+	// To be set before startSPI()
+	void setRecorder(Capture::Recorder *recorder);
+
+	void startSPI(Listener &listener);
+	void stopSPI();
+
+	Histogram &latency(FrameClass frameClass);
+	Histogram &transfers();
+
+	bool isUsing();
+};
+
+#endif // ATMEGA_H
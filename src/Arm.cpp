@@ -0,0 +1,482 @@
+/**
+ * @author pettinz
+ */
+
+#include "Arm.h"
+
+#include <climits>
+#include <cstdlib>
+#include <sstream>
+
+#include "CommandTable.h"
+
+#include "PolitoceanUtils.hpp"
+
+#include "ComponentsManager.hpp"
+
+#include "logger.h"
+
+void Listener::push(Commands::Skeleton::Action action, Direction direction, int velocity, long steps, long wristSteps)
+{
+    {
+        std::lock_guard<std::mutex> lock(actionsMutex_);
+        actions_.push({ action, direction, velocity, steps, wristSteps, std::chrono::steady_clock::now() });
+    }
+
+    actionsCv_.notify_one();
+}
+
+void Listener::move(const std::string& payload, Commands::Skeleton::Action to, Commands::Skeleton::Action by)
+{
+    std::istringstream stream(payload);
+    std::string mode;
+    long steps;
+
+    if (!(stream >> mode >> steps))
+        logger::getInstance().log(logger::WARNING, "Malformed move payload, dropped.");
+    else if (mode == Commands::Skeleton::Move::TO)
+        push(to, Direction::NONE, 0, steps);
+    else if (mode == Commands::Skeleton::Move::BY)
+        push(by, Direction::NONE, 0, steps);
+    else
+        logger::getInstance().log(logger::WARNING, "Unknown move mode, dropped.");
+}
+
+void Listener::reach(const std::string& payload)
+{
+    std::istringstream stream(payload);
+    std::string mode;
+    long shoulder, wrist;
+
+    if (!(stream >> mode >> shoulder >> wrist))
+        logger::getInstance().log(logger::WARNING, "Malformed reach payload, dropped.");
+    else if (mode == Commands::Skeleton::Move::TO)
+        push(Commands::Skeleton::ARM_REACH_TO, Direction::NONE, 0, shoulder, wrist);
+    else if (mode == Commands::Skeleton::Move::BY)
+        push(Commands::Skeleton::ARM_REACH_BY, Direction::NONE, 0, shoulder, wrist);
+    else
+        logger::getInstance().log(logger::WARNING, "Unknown reach mode, dropped.");
+}
+
+/**
+ * Text to identifier lookup for the Skeleton topics payloads.
+ * The payload texts are defined in politocean_common, so the table is sorted once at startup.
+ */
+const CommandTable<Commands::Skeleton::Payload> payloadsTable({
+    { Commands::Actions::ON,                Commands::Skeleton::Payload::ON     },
+    { Commands::Actions::OFF,               Commands::Skeleton::Payload::OFF    },
+    { Commands::Actions::START,             Commands::Skeleton::Payload::START  },
+    { Commands::Actions::STOP,              Commands::Skeleton::Payload::STOP   },
+    { Commands::Actions::Stepper::UP,       Commands::Skeleton::Payload::UP     },
+    { Commands::Actions::Stepper::DOWN,     Commands::Skeleton::Payload::DOWN   }},
+    Commands::Skeleton::Payload::NONE);
+
+void Listener::listenForShoulder(const std::string& payload, const std::string& topic)
+{
+    Histogram::Timer timer(callbacks_);
+
+    if (recorder_)
+        recorder_->message(topic, payload);
+
+    if (topic == Topics::SHOULDER)
+    {
+        switch (payloadsTable.find(payload))
+        {
+        case Commands::Skeleton::Payload::ON:
+            push(Commands::Skeleton::SHOULDER_ON);
+            break;
+        case Commands::Skeleton::Payload::OFF:
+            push(Commands::Skeleton::SHOULDER_OFF);
+            break;
+        case Commands::Skeleton::Payload::UP:
+            shoulderDirection_ = Direction::CCW;
+            push(Commands::Skeleton::SHOULDER_STEP, shoulderDirection_);
+            break;
+        case Commands::Skeleton::Payload::DOWN:
+            shoulderDirection_ = Direction::CW;
+            push(Commands::Skeleton::SHOULDER_STEP, shoulderDirection_);
+            break;
+        case Commands::Skeleton::Payload::STOP:
+            push(Commands::Skeleton::SHOULDER_STOP);
+            break;
+        default:
+            shoulderDirection_ = Direction::NONE;
+        }
+    }
+    else if (topic == Topics::SHOULDER_VELOCITY)
+    {
+
+    }
+    else if (topic == Topics::SHOULDER_MOVE)
+        move(payload, Commands::Skeleton::SHOULDER_MOVE_TO, Commands::Skeleton::SHOULDER_MOVE_BY);
+    else if (topic == Topics::SHOULDER_REACH)
+        reach(payload);
+    else return ;
+}
+
+void Listener::listenForWrist(const std::string& payload, const std::string& topic)
+{
+    Histogram::Timer timer(callbacks_);
+
+    if (recorder_)
+        recorder_->message(topic, payload);
+
+    if (topic == Topics::WRIST)
+    {
+        switch (payloadsTable.find(payload))
+        {
+        case Commands::Skeleton::Payload::ON:
+            push(Commands::Skeleton::WRIST_ON);
+            break;
+        case Commands::Skeleton::Payload::OFF:
+            push(Commands::Skeleton::WRIST_OFF);
+            break;
+        case Commands::Skeleton::Payload::START:
+            push(Commands::Skeleton::WRIST_START, wristDirection_, wristVelocity_);
+            break;
+        case Commands::Skeleton::Payload::STOP:
+            push(Commands::Skeleton::WRIST_STOP);
+            break;
+        default:
+            break;
+        }
+    }
+    else if (topic == Topics::WRIST_VELOCITY)
+        try
+        {
+            wristAxis(std::stoi(payload));
+        }
+        catch(const std::exception& e)
+        {
+            logger::getInstance().log(logger::WARNING, "Error while converting wrist velocity.", e);
+        }
+        catch(...)
+        {
+            logger::getInstance().log(logger::WARNING, "Error while converting wrist velocity.");
+        }
+    else return ;
+}
+
+void Listener::listenForHand(const std::string& payload, const std::string& topic)
+{
+    Histogram::Timer timer(callbacks_);
+
+    if (recorder_)
+        recorder_->message(topic, payload);
+
+    if (topic == Topics::HAND)
+    {
+        switch (payloadsTable.find(payload))
+        {
+        case Commands::Skeleton::Payload::START:
+            push(Commands::Skeleton::HAND_START, handDirection_, handVelocity_);
+            break;
+        case Commands::Skeleton::Payload::STOP:
+            push(Commands::Skeleton::HAND_STOP);
+            break;
+        default:
+            break;
+        }
+    }
+    else if (topic == Topics::HAND_VELOCITY)
+    {
+        try
+        {
+            handAxis(std::stoi(payload));
+        }
+        catch(const std::exception& e)
+        {
+            logger::getInstance().log(logger::WARNING, "Error while parsing hand velocity.", e);
+        }
+        catch(...)
+        {
+            logger::getInstance().log(logger::WARNING, "Error while parsing hand velocity.");
+        }
+    }
+    else return ;
+}
+
+void Listener::listenForHead(const std::string& payload, const std::string& topic)
+{
+    Histogram::Timer timer(callbacks_);
+
+    if (recorder_)
+        recorder_->message(topic, payload);
+
+    if (topic == Topics::HEAD)
+    {
+        switch (payloadsTable.find(payload))
+        {
+        case Commands::Skeleton::Payload::ON:
+            push(Commands::Skeleton::HEAD_ON);
+            break;
+        case Commands::Skeleton::Payload::OFF:
+            push(Commands::Skeleton::HEAD_OFF);
+            break;
+        case Commands::Skeleton::Payload::UP:
+            headDirection_ = Direction::CCW;
+            push(Commands::Skeleton::HEAD_STEP, headDirection_);
+            break;
+        case Commands::Skeleton::Payload::DOWN:
+            headDirection_ = Direction::CW;
+            push(Commands::Skeleton::HEAD_STEP, headDirection_);
+            break;
+        case Commands::Skeleton::Payload::STOP:
+            push(Commands::Skeleton::HEAD_STOP);
+            break;
+        default:
+            headDirection_ = Direction::NONE;
+        }
+    }
+    else if (topic == Topics::HEAD_MOVE)
+        move(payload, Commands::Skeleton::HEAD_MOVE_TO, Commands::Skeleton::HEAD_MOVE_BY);
+    else return ;
+}
+
+void Listener::wristAxis(int axis)
+{
+    int velocity        = 0;
+    Direction direction = Direction::NONE;
+
+    if (axis != 0)
+    {
+        direction   = axis > 0 ? Direction::CW : Direction::CCW;
+        velocity    = Politocean::map(std::abs(axis), 0, SHRT_MAX, Timing::Microseconds::WRIST_MAX, Timing::Microseconds::WRIST_MIN);
+    }
+
+    if (wristVelocity_ == velocity && wristDirection_ == direction)
+        return ;
+
+    wristVelocity_  = velocity;
+    wristDirection_ = direction;
+
+    // Retargets the wrist if it is running
+    push(Commands::Skeleton::WRIST_VELOCITY, wristDirection_, wristVelocity_);
+}
+
+void Listener::handAxis(int axis)
+{
+    int velocity        = axis;
+    Direction direction = Direction::NONE;
+
+    if (velocity > 0)
+        direction = Direction::CCW;
+    else if (velocity < 0)
+    {
+        direction = Direction::CW;
+        velocity = -axis;
+    }
+    else {}
+
+    velocity = Politocean::map(velocity, 0, SHRT_MAX, DCMotor::PWM_MIN, DCMotor::PWM_MAX);
+
+    if (handVelocity_ == velocity && handDirection_ == direction)
+        return ;
+
+    handVelocity_  = velocity;
+    handDirection_ = direction;
+}
+
+bool Listener::waitForAction(Action& action, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(actionsMutex_);
+
+    if (!actionsCv_.wait_for(lock, timeout, [&]() { return !actions_.empty(); }))
+        return false;
+
+    action = actions_.front();
+    actions_.pop();
+
+    return true;
+}
+
+void Listener::setRecorder(Capture::Recorder *recorder)
+{
+    recorder_ = recorder;
+}
+
+Histogram& Listener::callbacks()
+{
+    return callbacks_;
+}
+
+Arm::Arm(Controller &controller) :
+    lines_(controller),
+    head_(&controller, Pinout::CAMERA_EN, Pinout::CAMERA_DIR, Pinout::CAMERA_STEP),
+    shoulder_(&controller, Pinout::SHOULDER_EN, Pinout::SHOULDER_DIR, Pinout::SHOULDER_STEP),
+    wrist_(&controller, Pinout::WRIST_EN, Pinout::WRIST_DIR, Pinout::WRIST_STEP),
+    hand_(&controller, Pinout::HAND_DIR, Pinout::HAND_PWM, DCMotor::PWM_MIN, DCMotor::PWM_MAX)
+{}
+
+void Arm::useGpioChip(const std::string& chip)
+{
+    chip_ = chip;
+}
+
+void Arm::setup()
+{
+    head_.setup();
+    head_.setLimits(Profiles::HEAD_MIN_POSITION, Profiles::HEAD_MAX_POSITION);
+
+    shoulder_.setup();
+    shoulder_.setProfile(Profiles::SHOULDER_MAX_RATE, Profiles::SHOULDER_ACCELERATION, Profiles::SHOULDER_JERK);
+    shoulder_.setLimits(Profiles::SHOULDER_MIN_POSITION, Profiles::SHOULDER_MAX_POSITION);
+
+    wrist_.setup();
+    wrist_.setProfile(Profiles::WRIST_MAX_RATE, Profiles::WRIST_ACCELERATION, Profiles::WRIST_JERK);
+
+    hand_.setup();
+    hand_.setSlewRate(Profiles::HAND_SLEW_UP, Profiles::HAND_SLEW_DOWN);
+
+    // Requested once the pins have their initial levels, which the lines keep
+    if (!chip_.empty() && lines_.setup(chip_, {
+            Pinout::CAMERA_EN, Pinout::CAMERA_DIR, Pinout::CAMERA_STEP,
+            Pinout::SHOULDER_EN, Pinout::SHOULDER_DIR, Pinout::SHOULDER_STEP,
+            Pinout::WRIST_EN, Pinout::WRIST_DIR, Pinout::WRIST_STEP,
+            Pinout::HAND_DIR }, "PolitoceanSkeleton"))
+    {
+        head_.setLines(&lines_);
+        shoulder_.setLines(&lines_);
+        wrist_.setLines(&lines_);
+        hand_.setLines(&lines_);
+        motion_.setLines(&lines_);
+    }
+
+    motion_.add(head_);
+    motion_.add(shoulder_);
+    motion_.add(wrist_);
+    motion_.startScheduling();
+}
+
+void Arm::dispatch(const Action& action)
+{
+    queued_.record(std::chrono::steady_clock::now() - action.received);
+    Histogram::Timer timer(dispatches_);
+
+    switch (action.id)
+    {
+    case Commands::Skeleton::SHOULDER_ON:
+        shoulder_.enable();
+        ComponentsManager::SetComponentState(component_t::SHOULDER, Component::Status::ENABLED);
+        break;
+    case Commands::Skeleton::SHOULDER_OFF:
+        shoulder_.disable();
+        ComponentsManager::SetComponentState(component_t::SHOULDER, Component::Status::DISABLED);
+        break;
+    case Commands::Skeleton::SHOULDER_STEP:
+        shoulder_.setDirection(action.direction);
+        shoulder_.setVelocity(Timing::Microseconds::DFLT_STEPPER);
+        shoulder_.startStepping();
+        break;
+    case Commands::Skeleton::SHOULDER_STOP:
+        shoulder_.stopStepping();
+        break;
+    case Commands::Skeleton::SHOULDER_MOVE_TO:
+        shoulder_.setVelocity(Timing::Microseconds::DFLT_STEPPER);
+        shoulder_.moveTo(action.steps);
+        break;
+    case Commands::Skeleton::SHOULDER_MOVE_BY:
+        shoulder_.setVelocity(Timing::Microseconds::DFLT_STEPPER);
+        shoulder_.moveBy(action.steps);
+        break;
+    case Commands::Skeleton::WRIST_ON:
+        wrist_.enable();
+        ComponentsManager::SetComponentState(component_t::WRIST, Component::Status::ENABLED);
+        break;
+    case Commands::Skeleton::WRIST_OFF:
+        wrist_.disable();
+        ComponentsManager::SetComponentState(component_t::WRIST, Component::Status::DISABLED);
+        break;
+    case Commands::Skeleton::WRIST_START:
+        wrist_.setDirection(action.direction);
+        wrist_.setVelocity(action.velocity);
+        wrist_.startStepping();
+        break;
+    case Commands::Skeleton::WRIST_STOP:
+        wrist_.stopStepping();
+        break;
+    case Commands::Skeleton::WRIST_VELOCITY:
+        // The stick neither stops nor steers the wrist during a reach
+        if (!wrist_.isStepping() || motion_.isCoordinated(wrist_))
+            break;
+
+        // A centered stick stops the wrist instead of running it at velocity 0
+        if (action.direction == Direction::NONE)
+        {
+            wrist_.stopStepping();
+            break;
+        }
+
+        wrist_.setDirection(action.direction);
+        wrist_.setVelocity(action.velocity);
+        break;
+    case Commands::Skeleton::HAND_START:
+        hand_.setDirection(action.direction);
+        hand_.setVelocity(action.velocity);
+        hand_.startPwm();
+        break;
+    case Commands::Skeleton::HAND_STOP:
+        hand_.stopPwm();
+        break;
+    case Commands::Skeleton::HEAD_ON:
+        head_.enable();
+        ComponentsManager::SetComponentState(component_t::HEAD, Component::Status::ENABLED);
+        break;
+    case Commands::Skeleton::HEAD_OFF:
+        head_.disable();
+        ComponentsManager::SetComponentState(component_t::HEAD, Component::Status::DISABLED);
+        break;
+    case Commands::Skeleton::HEAD_STEP:
+        head_.setDirection(action.direction);
+        head_.setVelocity(Timing::Microseconds::DFLT_HEAD);
+        head_.startStepping();
+        break;
+    case Commands::Skeleton::HEAD_STOP:
+        head_.stopStepping();
+        break;
+    case Commands::Skeleton::HEAD_MOVE_TO:
+        head_.setVelocity(Timing::Microseconds::DFLT_HEAD);
+        head_.moveTo(action.steps);
+        break;
+    case Commands::Skeleton::HEAD_MOVE_BY:
+        head_.setVelocity(Timing::Microseconds::DFLT_HEAD);
+        head_.moveBy(action.steps);
+        break;
+    case Commands::Skeleton::ARM_REACH_TO:
+    case Commands::Skeleton::ARM_REACH_BY:
+        shoulder_.setVelocity(Timing::Microseconds::DFLT_STEPPER);
+        wrist_.setVelocity(Timing::Microseconds::WRIST_MIN);
+
+        if (!motion_.moveTogether({ { &shoulder_, action.steps }, { &wrist_, action.wristSteps } },
+                action.id == Commands::Skeleton::ARM_REACH_BY))
+            logger::getInstance().log(logger::WARNING, "Shoulder or wrist still moving, reach dropped.");
+        break;
+    default:
+        break;
+    }
+}
+
+bool Arm::isOnGpioChip()
+{
+    return lines_.isRequested();
+}
+
+Histogram& Arm::queued()
+{
+    return queued_;
+}
+
+Histogram& Arm::dispatches()
+{
+    return dispatches_;
+}
+
+Histogram& Arm::edgesLateness()
+{
+    return motion_.lateness();
+}
+
+unsigned long Arm::missedEdges()
+{
+    return head_.missedEdges() + shoulder_.missedEdges() + wrist_.missedEdges();
+}
@@ -0,0 +1,169 @@
+/**
+ * @author pettinz
+ */
+
+#ifndef ARM_H
+#define ARM_H
+
+#include "Controller.h"
+#include "DCMotor.h"
+#include "GpioLines.h"
+#include "Stepper.h"
+#include "MotionScheduler.h"
+#include "Capture.h"
+#include "Commands.h"
+#include "Histogram.h"
+#include "RovTopics.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <string>
+
+#include "PolitoceanConstants.h"
+
+using namespace Politocean;
+using namespace Politocean::RPi;
+using namespace Politocean::Constants;
+
+/**
+ * Acceleration profiles of the arm steppers.
+ * Rates are in steps/s, accelerations in steps/s^2 and jerks in steps/s^3.
+ */
+namespace Profiles
+{
+    const double SHOULDER_MAX_RATE      = 1e6 / (2 * Timing::Microseconds::DFLT_STEPPER);
+    const double SHOULDER_ACCELERATION  = 2000;
+    const double SHOULDER_JERK          = 20000;
+
+    const double WRIST_MAX_RATE         = 1e6 / (2 * Timing::Microseconds::WRIST_MIN);
+    const double WRIST_ACCELERATION     = 4000;
+    const double WRIST_JERK             = 0;
+
+    // Duty cycle slew rates of the hand, in PWM units per second
+    const int HAND_SLEW_UP              = 400;
+    const int HAND_SLEW_DOWN            = 800;
+
+    // Soft limits in steps from the position at startup, where the joints must be parked
+    const long SHOULDER_MIN_POSITION    = -3200;
+    const long SHOULDER_MAX_POSITION    = 3200;
+
+    const long HEAD_MIN_POSITION        = -800;
+    const long HEAD_MAX_POSITION        = 800;
+}
+
+/**
+ * Action for the dispatcher, with the direction and velocity of its joint
+ * at the time the command was received.
+ * @steps is the position or the steps of the MOVE actions, and of the shoulder
+ * for the REACH ones, whose wrist position or steps are in @wristSteps.
+ * @received is when it arrived from MQTT.
+ */
+struct Action
+{
+    Commands::Skeleton::Action id;
+    Direction direction;
+    int velocity;
+    long steps, wristSteps;
+    std::chrono::steady_clock::time_point received;
+};
+
+class Listener
+{
+    Direction shoulderDirection_, wristDirection_, handDirection_, headDirection_;
+    int shoulderVelocity_, wristVelocity_, handVelocity_, headVelocity_;
+
+    /**
+     * @actions_ is filled by the MQTT thread and drained by the dispatcher,
+     * which sleeps on @actionsCv_ until an action arrives.
+     */
+    std::queue<Action> actions_;
+    std::mutex actionsMutex_;
+    std::condition_variable actionsCv_;
+
+    // Time spent in the callbacks, recorded by the MQTT thread
+    Histogram callbacks_;
+
+    // Records the messages received, if set
+    Capture::Recorder *recorder_;
+
+    void push(Commands::Skeleton::Action action, Direction direction = Direction::NONE, int velocity = 0, long steps = 0, long wristSteps = 0);
+    // Parses a move payload and pushes the @to or @by action
+    void move(const std::string& payload, Commands::Skeleton::Action to, Commands::Skeleton::Action by);
+    // Parses a reach payload and pushes its action
+    void reach(const std::string& payload);
+
+    void wristAxis(int axes);
+    void handAxis(int axes);
+
+public:
+    Listener() :    shoulderDirection_(Direction::NONE), wristDirection_(Direction::NONE), handDirection_(Direction::NONE),
+                    headDirection_(Direction::NONE), shoulderVelocity_(0), wristVelocity_(0), handVelocity_(0), headVelocity_(0),
+                    recorder_(nullptr) {}
+
+    // Records every message received into @recorder, to be set before subscribing
+    void setRecorder(Capture::Recorder *recorder);
+
+    void listenForShoulder(const std::string& payload, const std::string& topic);
+    void listenForWrist(const std::string& payload, const std::string& topic);
+    void listenForHand(const std::string& payload, const std::string& topic);
+    void listenForHead(const std::string& payload, const std::string& topic);
+
+    // Waits up to @timeout for the next action, returns false if none arrived
+    bool waitForAction(Action& action, std::chrono::milliseconds timeout);
+
+    Histogram& callbacks();
+};
+
+/**
+ * Motors of the arm and of the camera head, moved by the actions of the Listener.
+ * The steppers share the thread of @motion_, which also runs the shoulder and wrist reaches.
+ */
+class Arm
+{
+    /**
+     * @chip_   : gpio chip driving the motor pins, empty to use the Controller
+     * @lines_  : motor pins requested from @chip_, outliving the motors threads
+     */
+    std::string chip_;
+    GpioLines lines_;
+
+    Stepper head_, shoulder_, wrist_;
+    DCMotor hand_;
+
+    MotionScheduler motion_;
+
+    /**
+     * Recorded by the dispatcher thread:
+     * @queued_     : time of the actions in the queue, from MQTT to dispatch()
+     * @dispatches_ : duration of dispatch()
+     */
+    Histogram queued_, dispatches_;
+
+public:
+    Arm(Controller &controller);
+
+    /**
+     * Drives the motor pins through the gpio character device @chip, e.g. /dev/gpiochip0,
+     * from setup() on. The Pinout numbers are used as the line offsets of @chip.
+     */
+    void useGpioChip(const std::string& chip);
+
+    // Sets up the motors and starts the steppers scheduler
+    void setup();
+
+    // Whether setup() could request the motor pins from the gpio chip
+    bool isOnGpioChip();
+
+    void dispatch(const Action& action);
+
+    Histogram& queued();
+    Histogram& dispatches();
+    // Delay of the steppers edges over their deadlines
+    Histogram& edgesLateness();
+
+    unsigned long missedEdges();
+};
+
+#endif // ARM_H